@@ -0,0 +1,102 @@
+/*
+    AllocationCounter.cpp
+
+    Replacements for the global allocation functions that count every call before handing it to malloc,
+    compiled in only with CARVE_COUNT_ALLOCATIONS.
+*/
+
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef CARVE_COUNT_ALLOCATIONS
+
+namespace
+{
+std::atomic<std::uint64_t> allocations{0};
+
+void *countedAllocation(std::size_t size) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+}
+
+void *operator new(std::size_t size)
+{
+    if (void *memory = countedAllocation(size))
+        return memory;
+
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAllocation(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAllocation(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept
+{
+    std::free(memory);
+}
+
+bool allocationCounter::enabled()
+{
+    return true;
+}
+
+std::uint64_t allocationCounter::count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool allocationCounter::enabled()
+{
+    return false;
+}
+
+std::uint64_t allocationCounter::count()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,22 @@
+/*
+    AllocationCounter.hpp
+
+    Counts the heap allocations the whole program makes, so benchmarks and tests can check that no
+    seam is removed at the cost of an allocation.
+*/
+
+#include <cstdint>
+
+#ifndef INCLUDED_ALLOCATIONCOUNTER_HPP
+#define INCLUDED_ALLOCATIONCOUNTER_HPP
+
+namespace allocationCounter
+{
+// True when the library is built with CARVE_COUNT_ALLOCATIONS, which replaces the global operator new
+bool enabled();
+
+// Allocations made through operator new so far, by any thread. Always 0 unless enabled
+std::uint64_t count();
+}
+
+#endif
@@ -0,0 +1,535 @@
+/*
+    BatchCarve.hpp
+
+    Batch mode of the command line, which carves every image of a directory or manifest on a
+    work-stealing pool, or in a pipeline of reading, carving and writing stages, and reports the throughput.
+*/
+
+#include "BoundedQueue.hpp"
+#include "ImageCarver.hpp"
+#include "ImageCarverBase.hpp"
+#include "MappedFile.hpp"
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#ifndef INCLUDED_BATCHCARVE_HPP
+#define INCLUDED_BATCHCARVE_HPP
+
+// One carver for every sample type and channel count a batch may meet, each created on first use and
+// kept, with its buffers, for the next image a worker takes
+template <int... ChannelCounts>
+class CarverSet
+{
+private:
+    std::tuple<std::unique_ptr<ImageCarver<std::uint8_t, ChannelCounts>>...,
+               std::unique_ptr<ImageCarver<std::uint16_t, ChannelCounts>>...>
+        carvers;
+
+    template <typename PixelT, int Channels>
+    ImageCarver<PixelT, Channels> &carver()
+    {
+        auto &slot = std::get<std::unique_ptr<ImageCarver<PixelT, Channels>>>(carvers);
+
+        if (!slot)
+            slot = std::make_unique<ImageCarver<PixelT, Channels>>();
+
+        return *slot;
+    }
+
+public:
+    // Calls carve(carver) with the carver matching imageData, whose channel count must be one of
+    // ChannelCounts, and returns what it returns
+    template <typename Carve>
+    int withCarver(const ImageCarverBase::pgmData &imageData, Carve carve)
+    {
+        int status = 1;
+        auto carveAs = [&](auto channels) {
+            if (imageData.maxValue > 255)
+                status = carve(this->carver<std::uint16_t, decltype(channels)::value>());
+            else
+                status = carve(this->carver<std::uint8_t, decltype(channels)::value>());
+        };
+
+        ((imageData.channels == ChannelCounts ? carveAs(std::integral_constant<int, ChannelCounts>()) : void()), ...);
+
+        return status;
+    }
+};
+
+// Paths of the images to carve: the .pgm and .ppm files of a directory in name order, leaving out the
+// outputs of earlier runs, or the lines of a manifest file, leaving out blank lines and # comments
+inline bool batchImages(const std::string &source, std::vector<std::string> &images)
+{
+    std::error_code error;
+
+    if (std::filesystem::is_directory(source, error))
+    {
+        for (const auto &entry : std::filesystem::directory_iterator(source, error))
+        {
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+            if (entry.is_regular_file(error) && (extension == ".pgm" || extension == ".ppm") &&
+                entry.path().filename().string().find("_processed_") == std::string::npos)
+                images.push_back(entry.path().string());
+        }
+
+        std::sort(images.begin(), images.end());
+        return !error;
+    }
+
+    std::ifstream manifest(source);
+    std::string line;
+
+    if (!manifest)
+        return false;
+
+    while (std::getline(manifest, line))
+    {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        line.erase(0, line.find_first_not_of(" \t"));
+
+        if (!line.empty() && line[0] != '#')
+            images.push_back(line);
+    }
+
+    return true;
+}
+
+// Settings every image of a batch is carved with, checked before any image is carved
+class BatchOptions : public ImageCarverBase
+{
+public:
+    using ImageCarverBase::parseSeamCounts;
+
+    int threads() const { return numThreads; }
+
+    // Whether a setting only applies to carving files one at a time
+    bool filesOnly() const { return memoryBudget > 0 || !cacheDirectory.empty(); }
+};
+
+// Workers of each pipeline stage, and the images each queue between two stages holds at most
+struct PipelineStages
+{
+    int readers;
+    int carvers;
+    int writers;
+    int queueDepth;
+};
+
+// Image on its way through the pipeline. Its buffers go on to the next image once it has been written
+struct PipelineImage
+{
+    std::string fileName;
+    ImageCarverBase::pgmData imageData;
+    std::uint64_t pixels = 0;
+    std::tuple<Image<std::uint8_t>, Image<std::uint16_t>> samples;
+};
+
+// Samples of image in the type carver works on
+template <typename PixelT, int Channels>
+Image<PixelT> &samplesFor(PipelineImage &image, const ImageCarver<PixelT, Channels> &)
+{
+    return std::get<Image<PixelT>>(image.samples);
+}
+
+// Time the workers of a stage spent on images, waiting for one from the stage before and waiting for
+// room in the queue to the stage after, in nanoseconds
+struct StageTimes
+{
+    std::atomic<std::int64_t> busy{0};
+    std::atomic<std::int64_t> starved{0};
+    std::atomic<std::int64_t> blocked{0};
+};
+
+// Reads and decodes images, carves them and formats and writes them out on separate workers, handing
+// images between the stages through bounded queues, so files are read and written while others are
+// carved. Each carver gets an equal share of the threads a carve may use. Reports the throughput and
+// how busy each stage was, the busiest being the bottleneck
+template <int... ChannelCounts>
+int carvePipeline(const std::vector<std::string> &images, std::vector<char *> carveArgs, const BatchOptions &options,
+                  const PipelineStages &stages)
+{
+    const int numVertical = std::max(BatchOptions::parseSeamCounts(carveArgs[2])[0], 0);
+    const int numHorizontal = std::max(std::atoi(carveArgs[3]), 0);
+    const int threadsPerCarver = std::max(1, options.threads() / stages.carvers);
+
+    BoundedQueue<std::unique_ptr<PipelineImage>> toCarve(stages.queueDepth);
+    BoundedQueue<std::unique_ptr<PipelineImage>> toWrite(stages.queueDepth);
+    StageTimes readTimes, carveTimes, writeTimes;
+
+    // Images whose buffers are free for the next file read. There are never more than the queues and
+    // workers hold
+    std::vector<std::unique_ptr<PipelineImage>> spareImages;
+    std::mutex spareMutex;
+
+    auto recycle = [&](std::unique_ptr<PipelineImage> image) {
+        std::lock_guard<std::mutex> lock(spareMutex);
+        spareImages.push_back(std::move(image));
+    };
+
+    std::atomic<std::size_t> nextImage{0};
+    std::atomic<int> readersLeft{stages.readers};
+    std::atomic<int> carversLeft{stages.carvers};
+    std::atomic<int> numFailed{0};
+    std::atomic<std::uint64_t> totalPixels{0};
+
+    // Nanoseconds since mark, moving mark on to now
+    auto lap = [](std::chrono::steady_clock::time_point &mark) {
+        const auto now = std::chrono::steady_clock::now();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - mark).count();
+        mark = now;
+        return static_cast<std::int64_t>(elapsed);
+    };
+
+    auto readStage = [&]() {
+        CarverSet<ChannelCounts...> carvers;
+        auto mark = std::chrono::steady_clock::now();
+
+        for (std::size_t n = nextImage++; n < images.size(); n = nextImage++)
+        {
+            std::unique_ptr<PipelineImage> image;
+
+            {
+                std::lock_guard<std::mutex> lock(spareMutex);
+
+                if (spareImages.empty())
+                    image = std::make_unique<PipelineImage>();
+                else
+                {
+                    image = std::move(spareImages.back());
+                    spareImages.pop_back();
+                }
+            }
+
+            image->fileName = images[n];
+            ImageCarverBase::pgmData &imageData = image->imageData;
+            MappedFile file(image->fileName.c_str());
+
+            if (!file.data() || !ImageCarverBase::readHeader(file, imageData) ||
+                ((imageData.channels != ChannelCounts) && ...))
+            {
+                std::cerr << image->fileName << " is not a valid "
+                          << (((ChannelCounts == 1) && ...) ? "PGM" : "PGM or PPM") << " image" << std::endl;
+                numFailed++;
+                recycle(std::move(image));
+                readTimes.busy += lap(mark);
+                continue;
+            }
+
+            const int status = carvers.withCarver(imageData, [&](auto &carver) {
+                return carver.readPixels(file, imageData, samplesFor(*image, carver)) ? 0 : 1;
+            });
+
+            if (status != 0)
+            {
+                std::cerr << image->fileName << " has a truncated or malformed raster" << std::endl;
+                numFailed++;
+                recycle(std::move(image));
+                readTimes.busy += lap(mark);
+                continue;
+            }
+
+            image->pixels = static_cast<std::uint64_t>(imageData.columns) * imageData.rows;
+            readTimes.busy += lap(mark);
+
+            toCarve.push(std::move(image));
+            readTimes.blocked += lap(mark);
+        }
+
+        if (--readersLeft == 0)
+            toCarve.close();
+    };
+
+    auto carveStage = [&]() {
+        CarverSet<ChannelCounts...> carvers;
+        ThreadPool threads(threadsPerCarver);
+        std::unique_ptr<PipelineImage> image;
+        auto mark = std::chrono::steady_clock::now();
+
+        while (toCarve.pop(image))
+        {
+            carveTimes.starved += lap(mark);
+
+            int width = 0, height = 0;
+            const int status = carvers.withCarver(image->imageData, [&](auto &carver) {
+                auto &samples = samplesFor(*image, carver);
+                width = samples.width;
+                height = samples.height;
+
+                carver.parseOptions(static_cast<int>(carveArgs.size()), carveArgs.data());
+                carver.useThreadPool(&threads);
+                return carver.carve(samples, width - numVertical, height - numHorizontal) ? 0 : 1;
+            });
+
+            carveTimes.busy += lap(mark);
+
+            if (status != 0)
+            {
+                std::cerr << "Cannot remove " << carveArgs[2] << " vertical and " << carveArgs[3]
+                          << " horizontal seams from " << image->fileName << ", a " << width << "x" << height
+                          << " image" << std::endl;
+                numFailed++;
+                recycle(std::move(image));
+                continue;
+            }
+
+            toWrite.push(std::move(image));
+            carveTimes.blocked += lap(mark);
+        }
+
+        carveTimes.starved += lap(mark);
+
+        if (--carversLeft == 0)
+            toWrite.close();
+    };
+
+    auto writeStage = [&]() {
+        CarverSet<ChannelCounts...> carvers;
+        std::unique_ptr<PipelineImage> image;
+        auto mark = std::chrono::steady_clock::now();
+
+        while (toWrite.pop(image))
+        {
+            writeTimes.starved += lap(mark);
+
+            carvers.withCarver(image->imageData, [&](auto &carver) {
+                const std::string outputName =
+                    carver.outputFileName(image->fileName, carveArgs[2], carveArgs[3], image->imageData.channels);
+                carver.writeImage(outputName, image->imageData, samplesFor(*image, carver));
+                return 0;
+            });
+
+            totalPixels += image->pixels;
+            recycle(std::move(image));
+            writeTimes.busy += lap(mark);
+        }
+
+        writeTimes.starved += lap(mark);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    {
+        std::vector<std::thread> workers;
+
+        for (auto i = 0; i < stages.readers; ++i)
+            workers.emplace_back(readStage);
+        for (auto i = 0; i < stages.carvers; ++i)
+            workers.emplace_back(carveStage);
+        for (auto i = 0; i < stages.writers; ++i)
+            workers.emplace_back(writeStage);
+
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const int numCarved = static_cast<int>(images.size()) - numFailed;
+
+    std::cout << "Carved " << numCarved << " of " << images.size() << " images with " << stages.readers
+              << " readers, " << stages.carvers << " carvers and " << stages.writers << " writers in "
+              << elapsed.count() << " s: " << numCarved / elapsed.count() << " images/s, "
+              << totalPixels / 1e6 / elapsed.count() << " MP/s" << std::endl;
+
+    // Shares of the time every worker of a stage had, in whole percent. Workers are done once there is no
+    // work left for them, while those of the same stage may still be busy
+    auto report = [&](const char *name, const StageTimes &times, const int &numWorkers) {
+        const double available = 1e9 * elapsed.count() * numWorkers / 100;
+        const int busy = static_cast<int>(times.busy / available + 0.5);
+        const int starved = static_cast<int>(times.starved / available + 0.5);
+        const int blocked = static_cast<int>(times.blocked / available + 0.5);
+
+        std::cout << name << ": busy " << busy << "%, waiting for input " << starved << "%, waiting for output "
+                  << blocked << "%, done " << std::max(0, 100 - busy - starved - blocked) << "%" << std::endl;
+    };
+
+    report("read ", readTimes, stages.readers);
+    report("carve", carveTimes, stages.carvers);
+    report("write", writeTimes, stages.writers);
+
+    std::cout << "Queues held " << toCarve.meanFill() << " of " << toCarve.capacity() << " images to carve and "
+              << toWrite.meanFill() << " of " << toWrite.capacity() << " to write on average" << std::endl;
+
+    return numFailed > 0 ? 1 : 0;
+}
+
+// carve_seam batch <directory|manifest> <vertical seams>[,...] <horizontal seams> [--workers=N]
+// [--split=MP] [--pipeline [--readers=R] [--writers=W] [--queue-depth=D]] [options...]. Each image is one
+// task of a work-stealing pool of N workers, all cores by default. Images of MP megapixels or more, 1 by
+// default, also take in every worker that goes idle while they are carved, for their energy and
+// cumulative energy passes. With --pipeline, R readers (1), N carvers and W writers (1) each take one
+// stage of every image instead, with queues of D images (N) between them. Other options apply to every image
+template <int... ChannelCounts>
+int carveBatch(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        std::cerr << "Usage: " << argv[0] << " batch <directory|manifest> <vertical seams>[,...] <horizontal seams>"
+                  << " [--workers=N] [--split=MP] [--pipeline [--readers=R] [--writers=W] [--queue-depth=D]]"
+                  << " [options...]" << std::endl;
+        return 1;
+    }
+
+    int numWorkers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    double splitPixels = 1e6;
+    bool pipeline = false;
+    PipelineStages stages = {1, 0, 1, 0};
+
+    // Arguments of every carve, as if each image had been given on its own
+    std::vector<char *> carveArgs = {argv[0], nullptr, argv[3], argv[4]};
+
+    for (auto n = 5; n < argc; ++n)
+    {
+        if (std::strncmp(argv[n], "--workers=", 10) == 0)
+            numWorkers = std::max(1, atoi(argv[n] + 10));
+        else if (std::strncmp(argv[n], "--split=", 8) == 0)
+            splitPixels = std::atof(argv[n] + 8) * 1e6;
+        else if (std::strcmp(argv[n], "--pipeline") == 0)
+            pipeline = true;
+        else if (std::strncmp(argv[n], "--readers=", 10) == 0)
+            stages.readers = std::max(1, atoi(argv[n] + 10));
+        else if (std::strncmp(argv[n], "--writers=", 10) == 0)
+            stages.writers = std::max(1, atoi(argv[n] + 10));
+        else if (std::strncmp(argv[n], "--queue-depth=", 14) == 0)
+            stages.queueDepth = std::max(1, atoi(argv[n] + 14));
+        else
+            carveArgs.push_back(argv[n]);
+    }
+
+    BatchOptions options;
+    if (!options.parseOptions(static_cast<int>(carveArgs.size()), carveArgs.data()))
+        return 1;
+
+    // Pipeline stages only ever hold one image, so every setting that writes more or goes back to the file is out
+    if (pipeline && (BatchOptions::parseSeamCounts(argv[3]).size() > 1 || options.filesOnly()))
+    {
+        std::cerr << "--pipeline carves one width per image, without --cache or --memory-budget" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> images;
+    if (!batchImages(argv[2], images))
+    {
+        std::cerr << "Could not read " << argv[2] << std::endl;
+        return 1;
+    }
+
+    if (pipeline)
+    {
+        stages.carvers = numWorkers;
+        stages.queueDepth = stages.queueDepth > 0 ? stages.queueDepth : numWorkers;
+        return carvePipeline<ChannelCounts...>(images, carveArgs, options, stages);
+    }
+
+    // Carver sets not in use by any task. There are never more than one per worker
+    std::vector<std::unique_ptr<CarverSet<ChannelCounts...>>> spareCarvers;
+    std::mutex spareMutex;
+
+    std::atomic<int> numFailed{0};
+    std::atomic<int> numSplit{0};
+    std::atomic<int> splitThreads{0};
+    std::atomic<std::uint64_t> totalPixels{0};
+
+    auto start = std::chrono::steady_clock::now();
+
+    {
+        WorkStealingPool workers(numWorkers);
+
+        for (const auto &image : images)
+        {
+            workers.submit([&, image]() {
+                std::unique_ptr<CarverSet<ChannelCounts...>> carvers;
+
+                {
+                    std::lock_guard<std::mutex> lock(spareMutex);
+
+                    if (spareCarvers.empty())
+                        carvers = std::make_unique<CarverSet<ChannelCounts...>>();
+                    else
+                    {
+                        carvers = std::move(spareCarvers.back());
+                        spareCarvers.pop_back();
+                    }
+                }
+
+                MappedFile file(image.c_str());
+                ImageCarverBase::pgmData imageData;
+
+                if (!file.data() || !ImageCarverBase::readHeader(file, imageData) ||
+                    ((imageData.channels != ChannelCounts) && ...))
+                {
+                    std::cerr << image << " is not a valid " << (((ChannelCounts == 1) && ...) ? "PGM" : "PGM or PPM")
+                              << " image" << std::endl;
+                    numFailed++;
+                }
+                else
+                {
+                    // Small images keep to the thread of their task, as the other workers have their own
+                    const std::uint64_t pixels = static_cast<std::uint64_t>(imageData.columns) * imageData.rows;
+                    WorkStealingPool::Helpers helpers(workers, pixels >= splitPixels ? numWorkers : 1);
+
+                    std::vector<char *> args = carveArgs;
+                    args[1] = const_cast<char *>(image.c_str());
+
+                    const int status = carvers->withCarver(imageData, [&](auto &carver) {
+                        carver.useThreadPool(&helpers.threads());
+                        carver.setQuiet(true);
+                        const int carved = carver.carve(static_cast<int>(args.size()), args.data());
+                        carver.useThreadPool(nullptr);
+                        return carved;
+                    });
+
+                    if (helpers.threads().size() > 1)
+                    {
+                        numSplit++;
+                        splitThreads += helpers.threads().size();
+                    }
+
+                    if (status == 0)
+                        totalPixels += pixels;
+                    else
+                        numFailed++;
+                }
+
+                std::lock_guard<std::mutex> lock(spareMutex);
+                spareCarvers.push_back(std::move(carvers));
+            });
+        }
+
+        workers.wait();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const int numCarved = static_cast<int>(images.size()) - numFailed;
+
+    std::cout << "Carved " << numCarved << " of " << images.size() << " images with " << numWorkers << " workers in "
+              << elapsed.count() << " s: " << numCarved / elapsed.count() << " images/s, "
+              << totalPixels / 1e6 / elapsed.count() << " MP/s" << std::endl;
+
+    if (numSplit > 0)
+        std::cout << numSplit << " large images split across " << static_cast<double>(splitThreads) / numSplit
+                  << " threads on average" << std::endl;
+
+    return numFailed > 0 ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+    BoundedQueue.hpp
+
+    Blocking queue of limited depth between the stages of a pipeline.
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#ifndef INCLUDED_BOUNDEDQUEUE_HPP
+#define INCLUDED_BOUNDEDQUEUE_HPP
+
+// Producers wait while the queue holds depth items and consumers while it is empty, so a slow stage holds
+// back the ones before it rather than letting items pile up. Also keeps track of how full it was over time
+template <typename T>
+class BoundedQueue
+{
+private:
+    std::deque<T> items;
+    const int depth;
+    bool closed = false;
+
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+
+    // Item count integrated over time since the queue was created, up to lastChange
+    std::chrono::steady_clock::time_point created;
+    std::chrono::steady_clock::time_point lastChange;
+    double itemSeconds = 0;
+
+    // Adds the time at the current item count since the last change. Called with the lock held
+    void account()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        itemSeconds += items.size() * std::chrono::duration<double>(now - lastChange).count();
+        lastChange = now;
+    }
+
+public:
+    explicit BoundedQueue(const int &maxItems) : depth(maxItems > 1 ? maxItems : 1)
+    {
+        created = lastChange = std::chrono::steady_clock::now();
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    int capacity() const { return depth; }
+
+    // Waits for room and appends item. Returns false, dropping item, once the queue is closed
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&]() { return closed || static_cast<int>(items.size()) < depth; });
+
+        if (closed)
+            return false;
+
+        this->account();
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Waits for an item and takes the oldest. Returns false once the queue is closed and empty
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&]() { return closed || !items.empty(); });
+
+        if (items.empty())
+            return false;
+
+        this->account();
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // No more items will come. Consumers still take those already queued
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    // Average number of items queued since the queue was created
+    double meanFill()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->account();
+
+        const double seconds = std::chrono::duration<double>(lastChange - created).count();
+        return seconds > 0 ? itemSeconds / seconds : 0;
+    }
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+    CarveApi.cpp
+
+    Implementation of the C interface, keeping one carver per sample type and channel count in each
+    context so their buffers are reused from one call to the next.
+*/
+
+#include "CarveApi.h"
+#include "ImageCarver.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <new>
+
+struct carve_context
+{
+    int threads = 0;
+    int batchSize = 1;
+    int compactInterval = -1;
+    bool compactDp = false;
+    int pyramidLevels = 0;
+    int bandWidth = 4;
+
+    std::unique_ptr<ImageCarver<std::uint8_t, 1>> grey8;
+    std::unique_ptr<ImageCarver<std::uint8_t, 3>> color8;
+    std::unique_ptr<ImageCarver<std::uint16_t, 1>> grey16;
+    std::unique_ptr<ImageCarver<std::uint16_t, 3>> color16;
+
+    // Carver that ran last, for carve_removed_energy
+    const ImageCarverBase *last = nullptr;
+
+    // Whether every setting is in range. Settings that conflict are left to the carver, which refuses them
+    bool settingsInRange() const
+    {
+        return threads >= 0 && batchSize >= 1 && compactInterval >= -1 && pyramidLevels >= 0 && bandWidth >= 1;
+    }
+
+    // Returns carver, created on first use, with the context's current settings
+    template <typename Carver>
+    Carver &configured(std::unique_ptr<Carver> &carver)
+    {
+        if (!carver)
+            carver = std::make_unique<Carver>();
+
+        if (threads > 0)
+            carver->setThreads(threads);
+        carver->setBatchSize(batchSize);
+        carver->setDeferredRemoval(compactInterval);
+        carver->setCompactDp(compactDp);
+        carver->setPyramidSearch(pyramidLevels, bandWidth);
+
+        last = carver.get();
+        return *carver;
+    }
+
+    // Carves with carver, configured, unless the settings are out of range or conflict
+    template <typename Carver, typename Carve>
+    int carveOn(std::unique_ptr<Carver> &carver, Carve carve)
+    {
+        if (!this->settingsInRange() || this->configured(carver).conflictingSettings())
+            return CARVE_INVALID_ARGUMENT;
+
+        return carve(*carver) ? CARVE_OK : CARVE_INVALID_ARGUMENT;
+    }
+};
+
+namespace
+{
+// Runs carve on the carver matching PixelT and channels, mapping failures to status codes
+template <typename PixelT, typename Carve>
+int carveWith(carve_context *context, const int &channels, Carve carve)
+{
+    if (!context || (channels != 1 && channels != 3))
+        return CARVE_INVALID_ARGUMENT;
+
+    try
+    {
+        if constexpr (sizeof(PixelT) == 1)
+            return channels == 1 ? context->carveOn(context->grey8, carve) : context->carveOn(context->color8, carve);
+        else
+            return channels == 1 ? context->carveOn(context->grey16, carve) : context->carveOn(context->color16, carve);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return CARVE_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        // No exception may reach a C caller
+        return CARVE_INTERNAL_ERROR;
+    }
+}
+
+template <typename PixelT>
+int carveInPlace(carve_context *context, PixelT *pixels, const int &width, const int &height, const size_t &stride,
+                 const int &channels, const int &targetWidth, const int &targetHeight)
+{
+    return carveWith<PixelT>(context, channels, [&](auto &carver) {
+        return carver.carve(pixels, width, height, stride, targetWidth, targetHeight);
+    });
+}
+
+template <typename PixelT>
+int carveInto(carve_context *context, const PixelT *pixels, const int &width, const int &height,
+              const size_t &stride, const int &channels, PixelT *output, const size_t &outputStride,
+              const int &targetWidth, const int &targetHeight)
+{
+    return carveWith<PixelT>(context, channels, [&](auto &carver) {
+        return carver.carve(pixels, width, height, stride, output, outputStride, targetWidth, targetHeight);
+    });
+}
+}
+
+carve_context *carve_create(void)
+{
+    return new (std::nothrow) carve_context();
+}
+
+void carve_destroy(carve_context *context)
+{
+    delete context;
+}
+
+void carve_set_threads(carve_context *context, int threads)
+{
+    if (context)
+        context->threads = threads;
+}
+
+void carve_set_batch_size(carve_context *context, int seams)
+{
+    if (context)
+        context->batchSize = seams;
+}
+
+void carve_set_deferred_removal(carve_context *context, int interval)
+{
+    if (context)
+        context->compactInterval = interval;
+}
+
+void carve_set_compact_dp(carve_context *context, int enabled)
+{
+    if (context)
+        context->compactDp = enabled != 0;
+}
+
+void carve_set_pyramid_search(carve_context *context, int levels, int band)
+{
+    if (!context)
+        return;
+
+    context->pyramidLevels = levels;
+    context->bandWidth = band;
+}
+
+int carve_u8(carve_context *context, uint8_t *pixels, int width, int height, size_t stride, int channels,
+             int target_width, int target_height)
+{
+    return carveInPlace(context, pixels, width, height, stride, channels, target_width, target_height);
+}
+
+int carve_u16(carve_context *context, uint16_t *pixels, int width, int height, size_t stride, int channels,
+              int target_width, int target_height)
+{
+    return carveInPlace(context, pixels, width, height, stride, channels, target_width, target_height);
+}
+
+int carve_u8_into(carve_context *context, const uint8_t *pixels, int width, int height, size_t stride, int channels,
+                  uint8_t *output, size_t output_stride, int target_width, int target_height)
+{
+    return carveInto(context, pixels, width, height, stride, channels, output, output_stride, target_width,
+                     target_height);
+}
+
+int carve_u16_into(carve_context *context, const uint16_t *pixels, int width, int height, size_t stride,
+                   int channels, uint16_t *output, size_t output_stride, int target_width, int target_height)
+{
+    return carveInto(context, pixels, width, height, stride, channels, output, output_stride, target_width,
+                     target_height);
+}
+
+uint64_t carve_removed_energy(const carve_context *context)
+{
+    return context && context->last ? context->last->removedEnergy() : 0;
+}
@@ -0,0 +1,83 @@
+/*
+    CarveApi.h
+
+    C interface to the carver for callers outside C++. Images are carved in memory from caller-owned
+    buffers of 8- or 16-bit samples, with 1 (grey) or 3 (RGB, interleaved) samples per pixel.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef INCLUDED_CARVEAPI_H
+#define INCLUDED_CARVEAPI_H
+
+#if defined(_WIN32)
+#ifdef CARVE_BUILDING_LIBRARY
+#define CARVE_API __declspec(dllexport)
+#else
+#define CARVE_API __declspec(dllimport)
+#endif
+#else
+#define CARVE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum carve_status
+{
+    CARVE_OK = 0,
+    CARVE_INVALID_ARGUMENT = 1,  // Null buffer, unsupported channel count, stride too short or above INT_MAX,
+                                 // target out of range, or settings out of range or in conflict
+    CARVE_OUT_OF_MEMORY = 2,
+    CARVE_INTERNAL_ERROR = 3  // Any other failure inside the carver, such as threads that could not be started
+};
+
+// Settings and buffers carried from one carve to the next. A context may be used by one thread at a time;
+// threads carving concurrently each need their own
+typedef struct carve_context carve_context;
+
+CARVE_API carve_context *carve_create(void);
+
+CARVE_API void carve_destroy(carve_context *context);
+
+// Same meaning as the command line options of the same names. A null context is ignored, see ImageCarverBase for the details. As on
+// the command line, at most one of batches above 1, deferred removal (an interval of 0 or more), compact
+// DP and pyramid search (levels above 0) can be on, and carves fail with CARVE_INVALID_ARGUMENT otherwise.
+// So do they for negative threads (0 keeping the default), batches below 1, intervals below -1, negative
+// levels and bands below 1
+CARVE_API void carve_set_threads(carve_context *context, int threads);
+
+CARVE_API void carve_set_batch_size(carve_context *context, int seams);
+
+CARVE_API void carve_set_deferred_removal(carve_context *context, int interval);
+
+CARVE_API void carve_set_compact_dp(carve_context *context, int enabled);
+
+CARVE_API void carve_set_pyramid_search(carve_context *context, int levels, int band);
+
+// Carves the width x height image at pixels, whose rows are stride samples apart, down to target_width x
+// target_height in place, leaving the result in the top left corner with the same stride
+CARVE_API int carve_u8(carve_context *context, uint8_t *pixels, int width, int height, size_t stride, int channels,
+                       int target_width, int target_height);
+
+CARVE_API int carve_u16(carve_context *context, uint16_t *pixels, int width, int height, size_t stride, int channels,
+                        int target_width, int target_height);
+
+// Same, leaving pixels untouched and writing the result to output, whose rows are output_stride samples apart
+CARVE_API int carve_u8_into(carve_context *context, const uint8_t *pixels, int width, int height, size_t stride,
+                            int channels, uint8_t *output, size_t output_stride, int target_width, int target_height);
+
+CARVE_API int carve_u16_into(carve_context *context, const uint16_t *pixels, int width, int height, size_t stride,
+                             int channels, uint16_t *output, size_t output_stride, int target_width,
+                             int target_height);
+
+// Sum of the energies of every pixel the last carve removed
+CARVE_API uint64_t carve_removed_energy(const carve_context *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,496 @@
+/*
+    EnergyKernels.cpp
+
+    Scalar, SSE4.1 and AVX2 versions of the energy kernels. The SIMD versions are compiled with
+    per-function target attributes, so the rest of the program keeps the baseline instruction set.
+*/
+
+#include "EnergyKernels.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ENERGY_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// The shared body of the energy kernels must be inlined into each target-specific wrapper to be
+// compiled for that instruction set
+#ifdef __GNUC__
+#define ENERGY_KERNELS_INLINE inline __attribute__((always_inline))
+#else
+#define ENERGY_KERNELS_INLINE inline
+#endif
+
+namespace energyKernels
+{
+    namespace
+    {
+        enum class Isa
+        {
+            Scalar,
+            Sse41,
+            Avx2
+        };
+
+        Isa detectIsa()
+        {
+#ifdef ENERGY_KERNELS_X86
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx2"))
+                return Isa::Avx2;
+            if (__builtin_cpu_supports("sse4.1"))
+                return Isa::Sse41;
+#endif
+            return Isa::Scalar;
+        }
+
+        const Isa isa = detectIsa();
+
+        // Fills interior entries [start, end) of a DP row, every one of which has three parents
+        using CumulativeInteriorFunction = void (*)(const Energy *, const Energy *, Energy *, int, int);
+
+        void cumulativeInteriorScalar(const Energy *energyRow, const Energy *prevRow, Energy *cRow, int start, int end)
+        {
+            for (auto j = start; j < end; ++j)
+            {
+                cRow[j] = saturatingAdd(energyRow[j], std::min(std::min(prevRow[j - 1], prevRow[j]), prevRow[j + 1]));
+            }
+        }
+
+#ifdef ENERGY_KERNELS_X86
+        // Unsigned saturating adds come from a + min(b, ~a), which never wraps
+        __attribute__((target("sse4.1"))) void cumulativeInteriorSse41(const Energy *energyRow, const Energy *prevRow,
+                                                                       Energy *cRow, int start, int end)
+        {
+            const __m128i ones = _mm_set1_epi32(-1);
+            auto j = start;
+
+            for (; j + 4 <= end; j += 4)
+            {
+                const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prevRow + j - 1));
+                const __m128i middle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prevRow + j));
+                const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prevRow + j + 1));
+                const __m128i energy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(energyRow + j));
+
+                const __m128i parent = _mm_min_epu32(_mm_min_epu32(left, middle), right);
+                const __m128i headroom = _mm_xor_si128(energy, ones);
+                const __m128i sum = _mm_add_epi32(energy, _mm_min_epu32(parent, headroom));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(cRow + j), sum);
+            }
+
+            cumulativeInteriorScalar(energyRow, prevRow, cRow, j, end);
+        }
+
+        __attribute__((target("avx2"))) void cumulativeInteriorAvx2(const Energy *energyRow, const Energy *prevRow,
+                                                                    Energy *cRow, int start, int end)
+        {
+            const __m256i ones = _mm256_set1_epi32(-1);
+            auto j = start;
+
+            for (; j + 8 <= end; j += 8)
+            {
+                const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prevRow + j - 1));
+                const __m256i middle = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prevRow + j));
+                const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prevRow + j + 1));
+                const __m256i energy = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(energyRow + j));
+
+                const __m256i parent = _mm256_min_epu32(_mm256_min_epu32(left, middle), right);
+                const __m256i headroom = _mm256_xor_si256(energy, ones);
+                const __m256i sum = _mm256_add_epi32(energy, _mm256_min_epu32(parent, headroom));
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(cRow + j), sum);
+            }
+
+            cumulativeInteriorSse41(energyRow, prevRow, cRow, j, end);
+        }
+#endif
+
+        CumulativeInteriorFunction selectCumulativeInterior()
+        {
+#ifdef ENERGY_KERNELS_X86
+            if (isa == Isa::Avx2)
+                return cumulativeInteriorAvx2;
+            if (isa == Isa::Sse41)
+                return cumulativeInteriorSse41;
+#endif
+            return cumulativeInteriorScalar;
+        }
+
+        const CumulativeInteriorFunction cumulativeInterior = selectCumulativeInterior();
+
+        // Fills interior entries [start, end) of an energy row, every one of which has a left and a
+        // right neighbour. Written without branches so each instruction set variant below is
+        // vectorized by the compiler, with the channel count fixed so interleaved samples are too
+        template <typename PixelT>
+        using EnergyInteriorFunction = void (*)(const PixelT *, const PixelT *, const PixelT *, Energy *, int, int, int);
+
+        template <int NumChannels, typename PixelT>
+        ENERGY_KERNELS_INLINE void energyInteriorBody(const PixelT *upRow, const PixelT *row, const PixelT *downRow,
+                                                      Energy *energyRow, int start, int end, int channelStep)
+        {
+            constexpr int pixelStep = planarLayout ? 1 : NumChannels;
+
+            // Only 16-bit color squares need more than 32 bits, everything else keeps the narrow lanes
+            constexpr bool wideSquares = NumChannels != 1 && sizeof(PixelT) > 1;
+            using Sum = std::conditional_t<wideSquares, ColorSquares, Energy>;
+
+            for (auto j = start; j < end; ++j)
+            {
+                Sum energy = 0;
+
+                for (auto k = 0; k < NumChannels; ++k)
+                {
+                    // Interleaved channels sit at a fixed offset, which keeps the loads easy to vectorize
+                    const int col = j * pixelStep + (planarLayout ? k * channelStep : k);
+                    const int value = row[col];
+                    const Sum gradient = std::abs(value - upRow[col]) + std::abs(value - downRow[col]) +
+                                         std::abs(value - row[col - pixelStep]) + std::abs(value - row[col + pixelStep]);
+
+                    if constexpr (NumChannels == 1)
+                        energy += gradient;
+                    else
+                        energy += gradient * gradient;
+                }
+
+                if constexpr (wideSquares)
+                    energyRow[j] = scaledColorEnergy(energy);
+                else
+                    energyRow[j] = energy;
+            }
+        }
+
+        template <int NumChannels, typename PixelT>
+        void energyInteriorScalar(const PixelT *upRow, const PixelT *row, const PixelT *downRow, Energy *energyRow,
+                                  int start, int end, int channelStep)
+        {
+            energyInteriorBody<NumChannels>(upRow, row, downRow, energyRow, start, end, channelStep);
+        }
+
+#ifdef ENERGY_KERNELS_X86
+        template <int NumChannels, typename PixelT>
+        __attribute__((target("sse4.1"))) void energyInteriorSse41(const PixelT *upRow, const PixelT *row,
+                                                                   const PixelT *downRow, Energy *energyRow,
+                                                                   int start, int end, int channelStep)
+        {
+            energyInteriorBody<NumChannels>(upRow, row, downRow, energyRow, start, end, channelStep);
+        }
+
+        template <int NumChannels, typename PixelT>
+        __attribute__((target("avx2"))) void energyInteriorAvx2(const PixelT *upRow, const PixelT *row,
+                                                                const PixelT *downRow, Energy *energyRow,
+                                                                int start, int end, int channelStep)
+        {
+            energyInteriorBody<NumChannels>(upRow, row, downRow, energyRow, start, end, channelStep);
+        }
+#endif
+
+        template <int NumChannels, typename PixelT>
+        EnergyInteriorFunction<PixelT> selectEnergyInterior()
+        {
+#ifdef ENERGY_KERNELS_X86
+            if (isa == Isa::Avx2)
+                return energyInteriorAvx2<NumChannels, PixelT>;
+            if (isa == Isa::Sse41)
+                return energyInteriorSse41<NumChannels, PixelT>;
+#endif
+            return energyInteriorScalar<NumChannels, PixelT>;
+        }
+
+        // Direction of the lowest parent of entry j of a line, 0 for j - 1, 1 for j and 2 for j + 1.
+        // Ties go to the left, then the middle parent, as in the seam trace
+        inline unsigned parentDirection(const Energy *prevLine, const int &j, const int &lineLength)
+        {
+            if (lineLength == 1)
+                return 1;
+            if (j == 0)
+                return prevLine[0] <= prevLine[1] ? 1 : 2;
+            if (j == lineLength - 1)
+                return prevLine[j - 1] <= prevLine[j] ? 0 : 1;
+
+            return (prevLine[j - 1] <= prevLine[j] && prevLine[j - 1] <= prevLine[j + 1]) ? 0
+                   : (prevLine[j] <= prevLine[j + 1] ? 1 : 2);
+        }
+
+        // Directions of entries 4b to 4b + 3, packed two bits each from the lowest bits up
+        std::uint8_t packedDirections(const Energy *prevLine, const int &b, const int &lineLength)
+        {
+            unsigned packed = 0;
+
+            for (auto j = 4 * b; j < std::min(4 * b + 4, lineLength); ++j)
+                packed |= parentDirection(prevLine, j, lineLength) << (2 * (j - 4 * b));
+
+            return static_cast<std::uint8_t>(packed);
+        }
+
+        // Fills bytes [start, end) of a packed direction row, every entry of which has three parents
+        using DirectionInteriorFunction = void (*)(const Energy *, std::uint8_t *, int, int);
+
+        void directionInteriorScalar(const Energy *prevLine, std::uint8_t *directions, int start, int end)
+        {
+            for (auto b = start; b < end; ++b)
+            {
+                unsigned packed = 0;
+
+                for (auto n = 0; n < 4; ++n)
+                {
+                    const int j = 4 * b + n;
+                    const Energy left = prevLine[j - 1];
+                    const Energy middle = prevLine[j];
+                    const Energy right = prevLine[j + 1];
+                    const unsigned direction = (left <= middle && left <= right) ? 0 : (middle <= right ? 1 : 2);
+
+                    packed |= direction << (2 * n);
+                }
+
+                directions[b] = static_cast<std::uint8_t>(packed);
+            }
+        }
+
+#ifdef ENERGY_KERNELS_X86
+        // Each lane's direction is shifted into its bit pair of the output byte, and the four lanes of a
+        // byte are then summed together, which never carries since the bit pairs do not overlap
+        __attribute__((target("sse4.1"))) void directionInteriorSse41(const Energy *prevLine, std::uint8_t *directions,
+                                                                       int start, int end)
+        {
+            const __m128i one = _mm_set1_epi32(1);
+            const __m128i two = _mm_set1_epi32(2);
+            const __m128i bitPairs = _mm_setr_epi32(1, 4, 16, 64);
+            auto b = start;
+
+            for (; b < end; ++b)
+            {
+                const Energy *entries = prevLine + 4 * b;
+                const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(entries - 1));
+                const __m128i middle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(entries));
+                const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(entries + 1));
+
+                const __m128i leftLowest = _mm_and_si128(_mm_cmpeq_epi32(_mm_min_epu32(left, middle), left),
+                                                         _mm_cmpeq_epi32(_mm_min_epu32(left, right), left));
+                const __m128i middleLowest = _mm_cmpeq_epi32(_mm_min_epu32(middle, right), middle);
+                const __m128i direction = _mm_andnot_si128(leftLowest, _mm_blendv_epi8(two, one, middleLowest));
+
+                __m128i packed = _mm_mullo_epi32(direction, bitPairs);
+                packed = _mm_hadd_epi32(packed, packed);
+                packed = _mm_hadd_epi32(packed, packed);
+
+                directions[b] = static_cast<std::uint8_t>(_mm_cvtsi128_si32(packed));
+            }
+        }
+
+        __attribute__((target("avx2"))) void directionInteriorAvx2(const Energy *prevLine, std::uint8_t *directions,
+                                                                    int start, int end)
+        {
+            const __m256i one = _mm256_set1_epi32(1);
+            const __m256i two = _mm256_set1_epi32(2);
+            const __m256i bitPairs = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+            auto b = start;
+
+            for (; b + 2 <= end; b += 2)
+            {
+                const Energy *entries = prevLine + 4 * b;
+                const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(entries - 1));
+                const __m256i middle = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(entries));
+                const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(entries + 1));
+
+                const __m256i leftLowest = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_min_epu32(left, middle), left),
+                                                            _mm256_cmpeq_epi32(_mm256_min_epu32(left, right), left));
+                const __m256i middleLowest = _mm256_cmpeq_epi32(_mm256_min_epu32(middle, right), middle);
+                const __m256i direction =
+                    _mm256_andnot_si256(leftLowest, _mm256_blendv_epi8(two, one, middleLowest));
+
+                __m256i packed = _mm256_sllv_epi32(direction, bitPairs);
+                packed = _mm256_hadd_epi32(packed, packed);
+                packed = _mm256_hadd_epi32(packed, packed);
+
+                directions[b] = static_cast<std::uint8_t>(_mm256_cvtsi256_si32(packed));
+                directions[b + 1] = static_cast<std::uint8_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1)));
+            }
+
+            directionInteriorSse41(prevLine, directions, b, end);
+        }
+#endif
+
+        DirectionInteriorFunction selectDirectionInterior()
+        {
+#ifdef ENERGY_KERNELS_X86
+            if (isa == Isa::Avx2)
+                return directionInteriorAvx2;
+            if (isa == Isa::Sse41)
+                return directionInteriorSse41;
+#endif
+            return directionInteriorScalar;
+        }
+
+        const DirectionInteriorFunction directionInterior = selectDirectionInterior();
+
+        // Fills coarse entries [start, end) of a pooled row, every one of which covers two columns
+        using PoolInteriorFunction = void (*)(const Energy *, const Energy *, Energy *, int, int);
+
+        void poolInteriorScalar(const Energy *topRow, const Energy *bottomRow, Energy *coarseRow, int start, int end)
+        {
+            for (auto j = start; j < end; ++j)
+                coarseRow[j] = (topRow[2 * j] + topRow[2 * j + 1] + bottomRow[2 * j] + bottomRow[2 * j + 1]) / 4;
+        }
+
+#ifdef ENERGY_KERNELS_X86
+        // The two rows are added first, then horizontal adds sum neighbouring columns
+        __attribute__((target("sse4.1"))) void poolInteriorSse41(const Energy *topRow, const Energy *bottomRow,
+                                                                  Energy *coarseRow, int start, int end)
+        {
+            auto j = start;
+
+            for (; j + 4 <= end; j += 4)
+            {
+                const __m128i low = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(topRow + 2 * j)),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottomRow + 2 * j)));
+                const __m128i high = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(topRow + 2 * j + 4)),
+                                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottomRow + 2 * j + 4)));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(coarseRow + j), _mm_srli_epi32(_mm_hadd_epi32(low, high), 2));
+            }
+
+            poolInteriorScalar(topRow, bottomRow, coarseRow, j, end);
+        }
+
+        // Horizontal adds work within 128-bit halves, so the 64-bit pairs come out interleaved and are put back in order
+        __attribute__((target("avx2"))) void poolInteriorAvx2(const Energy *topRow, const Energy *bottomRow,
+                                                               Energy *coarseRow, int start, int end)
+        {
+            auto j = start;
+
+            for (; j + 8 <= end; j += 8)
+            {
+                const __m256i low =
+                    _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(topRow + 2 * j)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottomRow + 2 * j)));
+                const __m256i high =
+                    _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(topRow + 2 * j + 8)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottomRow + 2 * j + 8)));
+                const __m256i sums = _mm256_permute4x64_epi64(_mm256_hadd_epi32(low, high), 0xd8);
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(coarseRow + j), _mm256_srli_epi32(sums, 2));
+            }
+
+            poolInteriorSse41(topRow, bottomRow, coarseRow, j, end);
+        }
+#endif
+
+        PoolInteriorFunction selectPoolInterior()
+        {
+#ifdef ENERGY_KERNELS_X86
+            if (isa == Isa::Avx2)
+                return poolInteriorAvx2;
+            if (isa == Isa::Sse41)
+                return poolInteriorSse41;
+#endif
+            return poolInteriorScalar;
+        }
+
+        const PoolInteriorFunction poolInterior = selectPoolInterior();
+    }
+
+    void cumulativeRow(const Energy *energyRow, const Energy *prevRow, Energy *cRow, const int &colStart,
+                       const int &colEnd, const int &numCols)
+    {
+        if (colStart >= colEnd)
+            return;
+
+        if (numCols == 1)
+        {
+            cRow[0] = saturatingAdd(energyRow[0], prevRow[0]);
+            return;
+        }
+
+        // Border columns only have two parents, so they are kept out of the vector loop
+        if (colStart == 0)
+            cRow[0] = saturatingAdd(energyRow[0], std::min(prevRow[0], prevRow[1]));
+
+        const int start = std::max(colStart, 1);
+        const int end = std::min(colEnd, numCols - 1);
+
+        if (start < end)
+            cumulativeInterior(energyRow, prevRow, cRow, start, end);
+
+        if (colEnd == numCols)
+            cRow[numCols - 1] = saturatingAdd(energyRow[numCols - 1], std::min(prevRow[numCols - 2], prevRow[numCols - 1]));
+    }
+
+    void parentDirections(const Energy *prevLine, std::uint8_t *directions, const int &lineLength)
+    {
+        const int numBytes = (lineLength + 3) / 4;
+
+        // Bytes holding a border entry go through the scalar path, the rest through the vector kernel
+        const int start = std::min(1, numBytes);
+        const int end = std::max(start, (lineLength - 1) / 4);
+
+        for (auto b = 0; b < start; ++b)
+            directions[b] = packedDirections(prevLine, b, lineLength);
+
+        if (start < end)
+            directionInterior(prevLine, directions, start, end);
+
+        for (auto b = end; b < numBytes; ++b)
+            directions[b] = packedDirections(prevLine, b, lineLength);
+    }
+
+    void poolRow(const Energy *topRow, const Energy *bottomRow, Energy *coarseRow, const int &colStart,
+                 const int &numCols)
+    {
+        const int end = numCols / 2;
+
+        if (colStart < end)
+            poolInterior(topRow, bottomRow, coarseRow, colStart, end);
+
+        // An odd last column stands in for its own missing neighbour
+        if (numCols % 2 && colStart <= end)
+            coarseRow[end] = (topRow[numCols - 1] + bottomRow[numCols - 1]) / 2;
+    }
+
+    template <typename PixelT>
+    void energyRow(const PixelT *upRow, const PixelT *row, const PixelT *downRow, Energy *energyRow,
+                   const int &numCols, const int &numChannels, const int &channelStep)
+    {
+        static const EnergyInteriorFunction<PixelT> greyInterior = selectEnergyInterior<1, PixelT>();
+        static const EnergyInteriorFunction<PixelT> colorInterior = selectEnergyInterior<3, PixelT>();
+
+        if (numCols <= 2 || (numChannels != 1 && numChannels != 3))
+        {
+            for (auto j = 0; j < numCols; ++j)
+                energyRow[j] = pixelEnergy(upRow, row, downRow, j, numCols, numChannels, channelStep);
+            return;
+        }
+
+        // Border columns use themselves as their missing neighbour, so they are kept out of the vector loop
+        energyRow[0] = pixelEnergy(upRow, row, downRow, 0, numCols, numChannels, channelStep);
+
+        if (numChannels == 1)
+            greyInterior(upRow, row, downRow, energyRow, 1, numCols - 1, channelStep);
+        else
+            colorInterior(upRow, row, downRow, energyRow, 1, numCols - 1, channelStep);
+
+        energyRow[numCols - 1] = pixelEnergy(upRow, row, downRow, numCols - 1, numCols, numChannels, channelStep);
+    }
+
+    template void energyRow(const uint8_t *, const uint8_t *, const uint8_t *, Energy *, const int &, const int &,
+                            const int &);
+    template void energyRow(const uint16_t *, const uint16_t *, const uint16_t *, Energy *, const int &, const int &,
+                            const int &);
+
+    const char *instructionSet()
+    {
+        switch (isa)
+        {
+        case Isa::Avx2:
+            return "avx2";
+        case Isa::Sse41:
+            return "sse4.1";
+        default:
+            return "scalar";
+        }
+    }
+}
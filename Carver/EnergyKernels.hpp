@@ -0,0 +1,108 @@
+/*
+    EnergyKernels.hpp
+
+    Vectorized inner loops of the energy and cumulative energy passes, with the fastest
+    implementation picked at runtime for the CPU the program runs on.
+*/
+
+#include "Image.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+#ifndef INCLUDED_ENERGYKERNELS_HPP
+#define INCLUDED_ENERGYKERNELS_HPP
+
+// Sample type of the energy and cumulative energy matrices. Unsigned 32-bit values let eight
+// lanes fit in an AVX2 register, and sums saturate instead of overflowing on very large images
+using Energy = std::uint32_t;
+
+namespace energyKernels
+{
+    const Energy maxEnergy = std::numeric_limits<Energy>::max();
+
+    // a + b, clamped to maxEnergy
+    inline Energy saturatingAdd(const Energy &a, const Energy &b)
+    {
+        const Energy sum = a + b;
+        return sum < a ? maxEnergy : sum;
+    }
+
+    // Sum of squared gradients of a 16-bit color pixel, which may not fit in Energy
+    using ColorSquares = std::uint64_t;
+
+    // Energy of a 16-bit color pixel from its full precision sum of squared gradients, scaled down by
+    // 2^16 so samples 256 times those of an 8-bit image get the same energies, and saturated
+    inline Energy scaledColorEnergy(const ColorSquares &squares)
+    {
+        const ColorSquares scaled = squares >> 16;
+        return scaled < maxEnergy ? static_cast<Energy>(scaled) : maxEnergy;
+    }
+
+    // Energy of the pixel at centre from the pixels above, below, left and right of it, each pointer
+    // addressing a pixel's first channel and further channels following channelStep samples apart.
+    // Grey images use the sum of absolute gradients, color images the sum of squared gradients per
+    // channel, 16-bit ones going through scaledColorEnergy
+    template <typename PixelT>
+    inline Energy pixelEnergy(const PixelT *centre, const PixelT *above, const PixelT *below, const PixelT *left,
+                              const PixelT *right, const int &numChannels, const int &channelStep)
+    {
+        ColorSquares energy = 0;
+
+        for (auto k = 0; k < numChannels; ++k)
+        {
+            const int offset = k * channelStep;
+            const int value = centre[offset];
+            const ColorSquares gradient = std::abs(value - above[offset]) + std::abs(value - below[offset]) +
+                                          std::abs(value - left[offset]) + std::abs(value - right[offset]);
+
+            energy += numChannels == 1 ? gradient : gradient * gradient;
+        }
+
+        if (sizeof(PixelT) > 1 && numChannels != 1)
+            return scaledColorEnergy(energy);
+
+        return static_cast<Energy>(energy);
+    }
+
+    // Energy of pixel j of row, whose neighbours above and below are in upRow and downRow. Pixels on
+    // the border use themselves in place of the missing neighbour
+    template <typename PixelT>
+    inline Energy pixelEnergy(const PixelT *upRow, const PixelT *row, const PixelT *downRow, const int &j,
+                              const int &numCols, const int &numChannels, const int &channelStep)
+    {
+        const int pixelStep = planarLayout ? 1 : numChannels;
+        const int leftCol = (j == 0 ? j : j - 1) * pixelStep;
+        const int col = j * pixelStep;
+        const int rightCol = (j == (numCols - 1) ? j : j + 1) * pixelStep;
+
+        return pixelEnergy(row + col, upRow + col, downRow + col, row + leftCol, row + rightCol, numChannels, channelStep);
+    }
+
+    // Fills a whole row of the energy matrix. upRow and downRow are the rows above and below,
+    // or row itself on the top and bottom edges
+    template <typename PixelT>
+    void energyRow(const PixelT *upRow, const PixelT *row, const PixelT *downRow, Energy *energyRow,
+                   const int &numCols, const int &numChannels, const int &channelStep);
+
+    // Fills entries [colStart, colEnd) of one row of the vertical cumulative energy DP from the
+    // row above it, numCols being the full width of the row
+    void cumulativeRow(const Energy *energyRow, const Energy *prevRow, Energy *cRow, const int &colStart,
+                       const int &colEnd, const int &numCols);
+
+    // Packs the direction of the lowest parent of every entry of a line into directions, two bits
+    // per entry and four entries per byte: 0 for the parent at j - 1, 1 at j and 2 at j + 1, ties
+    // going to the lowest index like the seam trace. Needs (lineLength + 3) / 4 bytes
+    void parentDirections(const Energy *prevLine, std::uint8_t *directions, const int &lineLength);
+
+    // Averages every 2 x 2 block of two rows of numCols energies into one entry of coarseRow, from
+    // coarse column colStart on. bottomRow may be topRow on the last row of an odd height
+    void poolRow(const Energy *topRow, const Energy *bottomRow, Energy *coarseRow, const int &colStart,
+                 const int &numCols);
+
+    // Name of the instruction set the kernels were selected for: "avx2", "sse4.1" or "scalar"
+    const char *instructionSet();
+}
+
+#endif
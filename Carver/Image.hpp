@@ -0,0 +1,265 @@
+/*
+    Image.hpp
+
+    Contiguous, strided image buffer used by every carving stage.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef INCLUDED_IMAGE_HPP
+#define INCLUDED_IMAGE_HPP
+
+// Color samples are interleaved (RGBRGB...) unless CARVE_PLANAR_COLOR is defined at compile time,
+// in which case every channel is kept in a plane of its own
+#ifdef CARVE_PLANAR_COLOR
+constexpr bool planarLayout = true;
+#else
+constexpr bool planarLayout = false;
+#endif
+
+// Row-major buffer holding width x height pixels of `channels` samples each. Rows are `stride`
+// samples apart, so seams can be removed by shrinking width in place. Planar images repeat that
+// layout once per channel, the planes being `planeStride` samples apart
+template <typename T>
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    int channels = 1;
+    int planeStride = 0;
+    std::vector<T> data;
+
+    // Samples kept outside data, such as in a memory-mapped file, used in its place when set. Copies
+    // share them, and reshape never reallocates them, so such images can only shrink
+    T *external = nullptr;
+
+    Image() = default;
+
+    Image(const int &numCols, const int &numRows, const int &numChannels = 1)
+        : width(numCols), height(numRows), stride(planarLayout ? numCols : numCols * numChannels),
+          channels(numChannels), planeStride(planarLayout ? numCols * numRows : 0),
+          data(static_cast<std::size_t>(numCols) * numChannels * numRows)
+    {
+    }
+
+    // Image over numCols x numRows pixels of numChannels samples at samples, laid out as data would be
+    // with rows rowStride samples apart, or packed if it is 0
+    static Image mapped(T *samples, const int &numCols, const int &numRows, const int &numChannels = 1,
+                        const int &rowStride = 0)
+    {
+        Image image;
+        image.width = numCols;
+        image.height = numRows;
+        image.stride = rowStride > 0 ? rowStride : planarLayout ? numCols : numCols * numChannels;
+        image.channels = numChannels;
+        image.planeStride = planarLayout ? numCols * numRows : 0;
+        image.external = samples;
+
+        return image;
+    }
+
+    // Samples from one pixel to the next along a row
+    int pixelStep() const { return planarLayout ? 1 : channels; }
+
+    // Samples from one channel of a pixel to the next
+    int channelStep() const { return planarLayout ? planeStride : 1; }
+
+    // Row i of the first channel. Channel k of pixel j is at row(i)[j * pixelStep() + k * channelStep()]
+    T *row(const int &i) { return (external ? external : data.data()) + static_cast<std::size_t>(i) * stride; }
+
+    const T *row(const int &i) const
+    {
+        return (external ? external : data.data()) + static_cast<std::size_t>(i) * stride;
+    }
+
+    T &at(const int &i, const int &j, const int &k = 0) { return row(i)[j * pixelStep() + k * channelStep()]; }
+
+    const T &at(const int &i, const int &j, const int &k = 0) const { return row(i)[j * pixelStep() + k * channelStep()]; }
+
+    // Copies row i from, or into, an array of width x channels interleaved samples
+    void setRow(const int &i, const T *samples)
+    {
+        for (int k = 0; k < (planarLayout ? channels : 1); ++k)
+        {
+            T *plane = row(i) + k * channelStep();
+
+            for (int j = 0; j < width * pixelStep(); ++j)
+                plane[j] = samples[planarLayout ? j * channels + k : j];
+        }
+    }
+
+    void getRow(const int &i, T *samples) const
+    {
+        for (int k = 0; k < (planarLayout ? channels : 1); ++k)
+        {
+            const T *plane = row(i) + k * channelStep();
+
+            for (int j = 0; j < width * pixelStep(); ++j)
+                samples[planarLayout ? j * channels + k : j] = plane[j];
+        }
+    }
+
+    // Changes the logical dimensions, reusing the existing allocation whenever it is large enough.
+    // Pixel contents are only preserved when neither the stride nor the plane size has to grow.
+    void reshape(const int &numCols, const int &numRows)
+    {
+        if (external)
+        {
+            width = numCols;
+            height = numRows;
+            return;
+        }
+
+        if (numCols * pixelStep() > stride)
+            stride = numCols * pixelStep();
+
+        if (planarLayout && stride * numRows > planeStride)
+            planeStride = stride * numRows;
+
+        const std::size_t size = planarLayout ? static_cast<std::size_t>(planeStride) * channels
+                                              : static_cast<std::size_t>(stride) * numRows;
+
+        if (data.size() < size)
+            data.resize(size);
+
+        width = numCols;
+        height = numRows;
+    }
+
+    // Removes pixel j from row i by moving the rest of the row left, one contiguous move per plane
+    void shiftOutPixel(const int &i, const int &j)
+    {
+        const int step = pixelStep();
+
+        for (int k = 0; k < (planarLayout ? channels : 1); ++k)
+        {
+            T *plane = row(i) + k * channelStep();
+            std::copy(plane + (j + 1) * step, plane + width * step, plane + j * step);
+        }
+    }
+
+    // Moves pixels columns[0], columns[1], ... of row i to the front of the row in that order. The
+    // columns must be increasing, so no pixel is overwritten before it has been moved
+    void gatherColumns(const int &i, const int *columns, const int &count)
+    {
+        const int step = pixelStep();
+
+        for (int k = 0; k < (planarLayout ? channels : 1); ++k)
+        {
+            T *plane = row(i) + k * channelStep();
+
+            for (int c = 0; c < count; ++c)
+            {
+                for (int n = 0; n < step; ++n)
+                    plane[c * step + n] = plane[columns[c] * step + n];
+            }
+        }
+    }
+
+    // Drops every pixel marked in mask, which must mark the same number of pixels, count, in every row
+    template <typename M>
+    void removeMaskedColumns(const Image<M> &mask, const int &count)
+    {
+        const int step = pixelStep();
+
+        for (int k = 0; k < (planarLayout ? channels : 1); ++k)
+        {
+            for (int i = 0; i < height; ++i)
+            {
+                T *plane = row(i) + k * channelStep();
+                const M *maskRow = mask.row(i);
+                int kept = 0;
+
+                for (int j = 0; j < width; ++j)
+                {
+                    if (maskRow[j])
+                        continue;
+
+                    for (int n = 0; n < step; ++n)
+                        plane[kept * step + n] = plane[j * step + n];
+                    kept++;
+                }
+            }
+        }
+
+        width -= count;
+    }
+
+    // Drops every pixel marked in mask, which must mark count pixels in every column. Rows are walked
+    // from the top, each pixel moving up by the number of marked pixels seen above it so far, which is
+    // counted in removedAbove so the caller can reuse its storage
+    template <typename M>
+    void removeMaskedRows(const Image<M> &mask, const int &count, std::vector<int> &removedAbove)
+    {
+        const int step = pixelStep();
+        removedAbove.resize(width);
+
+        for (int k = 0; k < (planarLayout ? channels : 1); ++k)
+        {
+            std::fill(removedAbove.begin(), removedAbove.end(), 0);
+
+            for (int i = 0; i < height; ++i)
+            {
+                const M *maskRow = mask.row(i);
+
+                for (int j = 0; j < width; ++j)
+                {
+                    if (maskRow[j])
+                        removedAbove[j]++;
+                    else if (removedAbove[j] > 0)
+                    {
+                        const T *from = row(i) + k * channelStep() + j * step;
+                        T *to = row(i - removedAbove[j]) + k * channelStep() + j * step;
+
+                        for (int n = 0; n < step; ++n)
+                            to[n] = from[n];
+                    }
+                }
+            }
+        }
+
+        height -= count;
+    }
+
+    // Removes one pixel per column, seam[j] being its row, by moving everything below it up a row.
+    // Walks the buffer row by row so the shift stays sequential in memory
+    void shiftOutHorizontalSeam(const std::vector<int> &seam)
+    {
+        const int top = *std::min_element(seam.begin(), seam.begin() + width);
+        const int bottom = *std::max_element(seam.begin(), seam.begin() + width);
+        const int step = pixelStep();
+
+        for (int k = 0; k < (planarLayout ? channels : 1); ++k)
+        {
+            for (int i = top; i < height - 1; ++i)
+            {
+                T *current = row(i) + k * channelStep();
+                const T *below = current + stride;
+
+                // Below the whole seam every pixel moves, so the row is copied in one go
+                if (i >= bottom)
+                {
+                    std::copy(below, below + width * step, current);
+                    continue;
+                }
+
+                for (int j = 0; j < width; ++j)
+                {
+                    if (i >= seam[j])
+                    {
+                        for (int n = 0; n < step; ++n)
+                            current[j * step + n] = below[j * step + n];
+                    }
+                }
+            }
+        }
+
+        height--;
+    }
+};
+
+#endif
@@ -0,0 +1,1272 @@
+/*
+    ImageCarver.hpp
+
+    Include file for the class that deals with carving, specialised at compile time for the sample
+    type and channel count of the image so the per-pixel loops work on a fixed number of channels.
+*/
+
+#include "AllocationCounter.hpp"
+#include "EnergyKernels.hpp"
+#include "Image.hpp"
+#include "ImageCarverBase.hpp"
+#include "MappedFile.hpp"
+#include "SeamMapCache.hpp"
+#include "Transpose.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef INCLUDED_IMAGECARVERCLASS_HPP
+#define INCLUDED_IMAGECARVERCLASS_HPP
+
+// PixelT is std::uint8_t or std::uint16_t, the narrowest type holding the header's maxValue, and
+// Channels 1 for PGM or 3 for PPM images
+template <typename PixelT, int Channels>
+class ImageCarver : public ImageCarverBase
+{
+    static_assert(Channels == 1 || Channels == 3, "Only grey and RGB images are carved");
+
+protected:
+    // Protected rather than private so that tests can drive the seam and energy steps one at a time
+
+    // Reused by writeImage to format ASCII rasters before they are written out in bulk
+    std::vector<char> outputBuffer;
+
+    // The image being carved and, when several widths are gathered from it, a copy of the original. Kept
+    // between carves with the other buffers, so carving a run of similar images reuses one allocation
+    Image<PixelT> workImage;
+    Image<PixelT> originalImage;
+
+    // One row of interleaved samples, and of big-endian bytes, for converting rows on their way in or out
+    std::vector<PixelT> sampleRow;
+    std::vector<unsigned char> byteRow;
+
+    // Runs the carving pipeline once the header is known to match PixelT and Channels
+    int carveImage(const MappedFile &file, pgmData &imageData, char *argv[]);
+
+    // Removes seams from imageMatrix until it is targetWidth x targetHeight, in whichever mode the settings
+    // select. Every entry point that produces a single output goes through here, so returns false, leaving
+    // the image alone, for conflicting settings as well as targets out of range
+    bool carvePixels(Image<PixelT> &imageMatrix, const int &targetWidth, const int &targetHeight);
+
+    // Exact or batched horizontal seam removal, shared by every output of a carve
+    void removeHorizontalSeams(Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                               std::vector<int> &seam, const int &numSeams);
+
+    // Removes numSeams vertical seams one at a time, recording the order pixels go in seamIndexMap.
+    // Batching and deferred removal do not apply, so every width gathered from it is exact
+    void buildSeamIndexMap(Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                           std::vector<int> &seam, const int &numSeams);
+
+    // Fills imageMatrix with original narrowed by its first numSeams vertical seams, in one pass over a
+    // seam index map whose rows are indexStride entries apart
+    template <typename IndexT>
+    void retargetWidth(const Image<PixelT> &original, const IndexT *seamIndices, const std::size_t &indexStride,
+                       const int &numSeams, Image<PixelT> &imageMatrix);
+
+    // Seam map cache key of an image
+    std::uint64_t seamMapKey(const Image<PixelT> &imageMatrix);
+
+    bool readRows(const char *&pos, const char *end, const pgmData &imageData, Image<PixelT> &imageArray);
+
+    // Grey images use the sum of absolute gradients, color images the sum of squared gradients per channel
+    void calculateEnergyMatrix(const Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix);
+
+    Energy calculatePixelEnergy(const Image<PixelT> &imageMatrix, const int &i, const int &j);
+
+    // Shift the energy matrix over a removed seam and recompute only the pixels bordering it
+    void updateVertEnergyMatrix(const Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix, const std::vector<int> &seam);
+
+    void updateHorizEnergyMatrix(const Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix, const std::vector<int> &seam);
+
+    // Records the column removed from each row in seam
+    void removeVerticalSeam(Image<PixelT> &imageMatrix, const Image<Energy> &cEnergyMatrix, std::vector<int> &seam);
+
+    // Records the row removed from each column in seam
+    void removeHorizontalSeam(Image<PixelT> &imageMatrix, const Image<Energy> &cEnergyMatrix, std::vector<int> &seam);
+
+    // Removes numSeams vertical seams without moving pixels: each seam is only dropped from
+    // columnMap, the energy and DP updates read and write through it, and the image and both
+    // matrices are compacted every compactInterval seams and after the last one
+    void removeVerticalSeamsDeferred(Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix,
+                                     Image<Energy> &cEnergyMatrix, std::vector<int> &seam, const int &numSeams);
+
+    void updateMappedVertEnergyMatrix(const Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix,
+                                      const std::vector<int> &seam);
+
+    // Removes a batch of seams from the image, returning how many were removed
+    int removeVerticalSeamBatch(Image<PixelT> &imageMatrix, const Image<Energy> &energyMatrix,
+                                const Image<Energy> &cEnergyMatrix, const int &maxSeams);
+
+    int removeHorizontalSeamBatch(Image<PixelT> &imageMatrix, const Image<Energy> &energyMatrix,
+                                  const Image<Energy> &cEnergyMatrix, const int &maxSeams);
+
+    void removeCompactSeam(Image<PixelT> &imageMatrix, const Image<Energy> &energyMatrix, std::vector<int> &seam,
+                           const bool &vertical);
+
+    // Carves with the pixels in mapped scratch files and a checkpointed DP, holding at most memoryBudget bytes.
+    // carveImage has already checked that the seam counts fit
+    int carveOutOfCore(const MappedFile &file, pgmData &imageData, char *argv[]);
+
+    void removeVerticalSeamsCheckpointed(Image<PixelT> &imageMatrix, std::vector<int> &seam, const int &numSeams);
+
+    // Moves the pixels listed in columnMap together and resets it to the identity
+    void compactColumns(Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix);
+
+public:
+    // Same arguments as printUsage lists. Fails on images whose channel count or sample size does not
+    // match this specialisation, withImageCarver picks the one that does
+    int carve(int argc, char *argv[]);
+
+    // Carves the width x height image at pixels, Channels interleaved samples per pixel and rows stride
+    // samples apart, down to targetWidth x targetHeight in place. The result is left in the top left
+    // corner with the same stride, which must fit in an int. Returns false, leaving the pixels alone, unless
+    // the target is at least 1 x 1 and no larger than the image and the settings do not conflict. Out-of-core carving and the seam
+    // map cache only apply to files
+    bool carve(PixelT *pixels, const int &width, const int &height, const std::size_t &stride,
+               const int &targetWidth, const int &targetHeight);
+
+    // Same, leaving pixels untouched and writing the targetWidth x targetHeight result to output, whose
+    // rows are outputStride samples apart
+    bool carve(const PixelT *pixels, const int &width, const int &height, const std::size_t &stride, PixelT *output,
+               const std::size_t &outputStride, const int &targetWidth, const int &targetHeight);
+    // The read, carve and write steps of carve(argc, argv) one at a time, for callers that read and write
+    // some images while others are carved. Each may run on a different carver, the carving one set up with
+    // parseOptions. readPixels decodes the raster of a file whose header readHeader accepted for this
+    // specialisation and returns false if it is malformed
+    bool readPixels(const MappedFile &file, const pgmData &imageData, Image<PixelT> &imageArray);
+
+    // Same as the in-place carve of a caller's buffer, on an image of the carver's own layout
+    bool carve(Image<PixelT> &image, const int &targetWidth, const int &targetHeight);
+
+    // Writes image in the encoding of imageData. ASCII lines are wrapped at lineLength characters, 0 puts
+    // each image row on a single line
+    void writeImage(const std::string &fileName, const pgmData &imageData, const Image<PixelT> &image,
+                    const int &lineLength = 70);
+};
+
+// Calls carve(carver) with the ImageCarver matching the header of fileName, as long as its channel
+// count is one of ChannelCounts, and returns what it returns
+template <int... ChannelCounts, typename Carve>
+int withImageCarver(const char *fileName, Carve carve)
+{
+    MappedFile file(fileName);
+    ImageCarverBase::pgmData imageData;
+
+    if (!file.data())
+    {
+        std::cerr << "Could not read " << fileName << std::endl;
+        return 1;
+    }
+
+    // Format is taken from the magic number rather than the file extension
+    if (!ImageCarverBase::readHeader(file, imageData) || ((imageData.channels != ChannelCounts) && ...))
+    {
+        std::cerr << fileName << " is not a valid " << (((ChannelCounts == 1) && ...) ? "PGM" : "PGM or PPM") << " image"
+                  << std::endl;
+        return 1;
+    }
+
+    // Pick the narrowest sample type that holds maxValue
+    int status = 1;
+    auto carveAs = [&](auto channels) {
+        if (imageData.maxValue > 255)
+        {
+            ImageCarver<std::uint16_t, decltype(channels)::value> carver;
+            status = carve(carver);
+        }
+        else
+        {
+            ImageCarver<std::uint8_t, decltype(channels)::value> carver;
+            status = carve(carver);
+        }
+    };
+
+    ((imageData.channels == ChannelCounts ? carveAs(std::integral_constant<int, ChannelCounts>()) : void()), ...);
+
+    return status;
+}
+
+// Carves out vertical and horizontal seams of an image
+template <typename PixelT, int Channels>
+int ImageCarver<PixelT, Channels>::carve(int argc, char *argv[])
+{
+    if (!this->parseOptions(argc, argv))
+        return 1;
+
+    MappedFile file(argv[1]);
+    pgmData imageData;
+
+    if (!file.data())
+    {
+        std::cerr << "Could not read " << argv[1] << std::endl;
+        return 1;
+    }
+
+    if (!readHeader(file, imageData) || imageData.channels != Channels ||
+        (imageData.maxValue > 255) != (sizeof(PixelT) > 1))
+    {
+        std::cerr << argv[1] << " is not a valid " << (Channels == 1 ? "PGM" : "PPM") << " image with "
+                  << 8 * sizeof(PixelT) << "-bit samples" << std::endl;
+        return 1;
+    }
+
+    return this->carveImage(file, imageData, argv);
+}
+
+// Carves a caller's interleaved image in place, straight in its buffer unless channels are kept in planes
+template <typename PixelT, int Channels>
+bool ImageCarver<PixelT, Channels>::carve(PixelT *pixels, const int &width, const int &height, const std::size_t &stride,
+                                          const int &targetWidth, const int &targetHeight)
+{
+    // Image rows are an int number of samples apart, so longer strides cannot be mapped
+    if (!pixels || width < 1 || height < 1 || stride < static_cast<std::size_t>(width) * Channels ||
+        stride > static_cast<std::size_t>(std::numeric_limits<int>::max()) || targetWidth < 1 || targetHeight < 1 ||
+        targetWidth > width || targetHeight > height)
+        return false;
+
+    if constexpr (!planarLayout)
+    {
+        Image<PixelT> image = Image<PixelT>::mapped(pixels, width, height, Channels, static_cast<int>(stride));
+        return this->carvePixels(image, targetWidth, targetHeight);
+    }
+
+    return this->carve(pixels, width, height, stride, pixels, stride, targetWidth, targetHeight);
+}
+
+// Carves a copy of a caller's interleaved image into another buffer
+template <typename PixelT, int Channels>
+bool ImageCarver<PixelT, Channels>::carve(const PixelT *pixels, const int &width, const int &height,
+                                          const std::size_t &stride, PixelT *output, const std::size_t &outputStride,
+                                          const int &targetWidth, const int &targetHeight)
+{
+    // Strides are held to the same int range as the in-place carve, which runs through here for planar images
+    const std::size_t maxStride = std::numeric_limits<int>::max();
+
+    if (!pixels || !output || width < 1 || height < 1 || stride < static_cast<std::size_t>(width) * Channels ||
+        outputStride < static_cast<std::size_t>(targetWidth) * Channels || stride > maxStride ||
+        outputStride > maxStride || targetWidth < 1 || targetHeight < 1 || targetWidth > width || targetHeight > height)
+        return false;
+
+    workImage.channels = Channels;
+    workImage.reshape(width, height);
+
+    for (auto i = 0; i < height; ++i)
+        workImage.setRow(i, pixels + i * stride);
+
+    if (!this->carvePixels(workImage, targetWidth, targetHeight))
+        return false;
+
+    for (auto i = 0; i < targetHeight; ++i)
+        workImage.getRow(i, output + i * outputStride);
+
+    return true;
+}
+
+// Carves an image read by readPixels in place
+template <typename PixelT, int Channels>
+bool ImageCarver<PixelT, Channels>::carve(Image<PixelT> &image, const int &targetWidth, const int &targetHeight)
+{
+    return this->carvePixels(image, targetWidth, targetHeight);
+}
+
+// Carves an image whose samples are stored as PixelT
+template <typename PixelT, int Channels>
+int ImageCarver<PixelT, Channels>::carveImage(const MappedFile &file, pgmData &imageData, char *argv[])
+{
+    // Every width must fit before the first is written, whichever path carves it, so that caching or
+    // carving out of core never changes which requests are accepted
+    if (!seamCountsFit(argv[2], argv[3], imageData.columns, imageData.rows))
+        return 1;
+
+    // Images that may not fit in memory are carved straight out of mapped files
+    if (memoryBudget > 0)
+        return this->carveOutOfCore(file, imageData, argv);
+
+    // Several vertical seam counts share one seam index map, each output being gathered from it. With a
+    // cache the map goes through it even for a single count
+    const std::vector<int> verticalSeams = parseSeamCounts(argv[2]);
+    const int horizontalSeams = atoi(argv[3]);
+
+    // Read pixel data into the image kept from the last carve, then grow every buffer the seams need
+    Image<PixelT> &pgmValues = workImage;
+    if (!this->readPixels(file, imageData, pgmValues))
+    {
+        std::cerr << argv[1] << " has a truncated or malformed raster" << std::endl;
+        return 1;
+    }
+
+    if (verticalSeams.size() > 1 || !cacheDirectory.empty())
+    {
+        this->reserveArena(imageData.columns, imageData.rows);
+        loopAllocations = 0;
+
+        originalImage = pgmValues;
+        const Image<PixelT> &original = originalImage;
+        const int maxSeams = *std::max_element(verticalSeams.begin(), verticalSeams.end());
+
+        // A cached map recording at least maxSeams seams skips every energy and DP pass
+        std::unique_ptr<SeamMapCache> cache;
+        std::unique_ptr<MappedFile> cachedMap;
+        std::uint64_t key = 0;
+
+        if (!cacheDirectory.empty())
+        {
+            cache = std::make_unique<SeamMapCache>(cacheDirectory, cacheLimit);
+            key = this->seamMapKey(original);
+            cachedMap = cache->find(key, original.width, original.height, maxSeams);
+        }
+
+        if (!cachedMap)
+        {
+            this->buildSeamIndexMap(pgmValues, pixelEnergy, cumulativeEnergy, currentSeam, maxSeams);
+
+            if (cache && !cache->store(key, seamIndexMap, maxSeams))
+                std::cerr << "Could not write to seam map cache " << cacheDirectory << std::endl;
+        }
+
+        for (auto numSeams : verticalSeams)
+        {
+            if (!cachedMap)
+                this->retargetWidth(original, seamIndexMap.row(0), seamIndexMap.stride, numSeams, pgmValues);
+            else if (SeamMapCache::header(*cachedMap).indexBytes == 2)
+                this->retargetWidth(original, static_cast<const std::uint16_t *>(SeamMapCache::indices(*cachedMap)),
+                                    original.width, numSeams, pgmValues);
+            else
+                this->retargetWidth(original, static_cast<const std::uint32_t *>(SeamMapCache::indices(*cachedMap)),
+                                    original.width, numSeams, pgmValues);
+
+            this->calculateEnergyMatrix(pgmValues, pixelEnergy);
+
+            const std::uint64_t allocationsBefore = allocationCounter::count();
+            this->removeHorizontalSeams(pgmValues, pixelEnergy, cumulativeEnergy, currentSeam, horizontalSeams);
+            loopAllocations += allocationCounter::count() - allocationsBefore;
+
+            imageData.columns = pgmValues.width;
+            imageData.rows = pgmValues.height;
+            this->writeImage(this->outputFileName(argv[1], std::to_string(numSeams), argv[3], Channels),
+                             imageData, pgmValues);
+        }
+
+        if (quiet)
+            return 0;
+
+        if (verticalSeams.size() > 1)
+            std::cout << "\n" << verticalSeams.size() << " new images generated" << std::endl;
+        else
+            std::cout << "\nNew image generated" << std::endl;
+
+        return 0;
+    }
+
+    // A single output is carved like any caller's image, negative counts removing nothing as before
+    if (!this->carvePixels(pgmValues, pgmValues.width - std::max(verticalSeams[0], 0),
+                           pgmValues.height - std::max(horizontalSeams, 0)))
+    {
+        std::cerr << "Cannot remove " << argv[2] << " vertical and " << argv[3] << " horizontal seams from a "
+                  << pgmValues.width << "x" << pgmValues.height << " image" << std::endl;
+        return 1;
+    }
+
+    imageData.columns = pgmValues.width;
+    imageData.rows = pgmValues.height;
+
+    // Create new image next to the input, with the extension matching its format
+    this->writeImage(this->outputFileName(argv[1], argv[2], argv[3], Channels), imageData, pgmValues);
+    if (!quiet)
+        std::cout << "\nNew image generated" << std::endl;
+
+    return 0;
+}
+
+// Removes width - targetWidth vertical seams, then height - targetHeight horizontal ones
+template <typename PixelT, int Channels>
+bool ImageCarver<PixelT, Channels>::carvePixels(Image<PixelT> &imageMatrix, const int &targetWidth,
+                                                const int &targetHeight)
+{
+    if (targetWidth < 1 || targetHeight < 1 || targetWidth > imageMatrix.width || targetHeight > imageMatrix.height ||
+        this->conflictingSettings())
+        return false;
+
+    const int numVertical = imageMatrix.width - targetWidth;
+    const int numHorizontal = imageMatrix.height - targetHeight;
+
+    this->reserveArena(imageMatrix.width, imageMatrix.height);
+
+    // Calculate Energy Matrices, the compact DP keeping no cumulative matrix between seams
+    this->calculateEnergyMatrix(imageMatrix, pixelEnergy);
+    if (batchSize > 1 || (!compactDp && pyramidLevels == 0))
+        this->vertCumulativeEnergy(pixelEnergy, cumulativeEnergy);
+
+    totalRemovedEnergy = 0;
+    const std::uint64_t allocationsBefore = allocationCounter::count();
+
+    // Remove vert seams, in batches recomputing everything after each one, or one at a time shifting
+    // each seam out straight away unless removal is deferred
+    if (batchSize > 1)
+    {
+        for (auto remaining = numVertical; remaining > 0;)
+        {
+            remaining -= this->removeVerticalSeamBatch(imageMatrix, pixelEnergy, cumulativeEnergy,
+                                                       std::min(batchSize, remaining));
+
+            this->calculateEnergyMatrix(imageMatrix, pixelEnergy);
+            if (remaining > 0)
+                this->vertCumulativeEnergy(pixelEnergy, cumulativeEnergy);
+        }
+    }
+    else if (compactDp)
+    {
+        for (auto i = 0; i < numVertical; ++i)
+        {
+            this->removeCompactSeam(imageMatrix, pixelEnergy, currentSeam, true);
+            totalRemovedEnergy += this->seamEnergy(pixelEnergy, currentSeam, true);
+
+            this->updateVertEnergyMatrix(imageMatrix, pixelEnergy, currentSeam);
+        }
+    }
+    else if (pyramidLevels > 0)
+    {
+        // Columns of each row from which the energy changed since the pyramid was last built
+        changedColumns.assign(imageMatrix.height, 0);
+
+        for (auto i = 0; i < numVertical; ++i)
+        {
+            this->findVerticalSeamPyramid(pixelEnergy, cumulativeEnergy, currentSeam, changedColumns);
+            totalRemovedEnergy += this->seamEnergy(pixelEnergy, currentSeam, true);
+
+            for (auto r = 0; r < imageMatrix.height; ++r)
+            {
+                imageMatrix.shiftOutPixel(r, currentSeam[r]);
+                changedColumns[r] = std::max(currentSeam[r] - 1, 0);
+            }
+            imageMatrix.width--;
+
+            this->updateVertEnergyMatrix(imageMatrix, pixelEnergy, currentSeam);
+        }
+    }
+    else if (compactInterval >= 0)
+        this->removeVerticalSeamsDeferred(imageMatrix, pixelEnergy, cumulativeEnergy, currentSeam, numVertical);
+    else
+    {
+        for (auto i = 0; i < numVertical; ++i)
+        {
+            this->removeVerticalSeam(imageMatrix, cumulativeEnergy, currentSeam);
+            totalRemovedEnergy += this->seamEnergy(pixelEnergy, currentSeam, true);
+
+            this->updateVertEnergyMatrix(imageMatrix, pixelEnergy, currentSeam);
+            this->updateVertCumulativeEnergy(pixelEnergy, cumulativeEnergy, currentSeam);
+        }
+    }
+
+    // Remove horiz seams in place, the energy matrix is already up to date
+    this->removeHorizontalSeams(imageMatrix, pixelEnergy, cumulativeEnergy, currentSeam, numHorizontal);
+    loopAllocations = allocationCounter::count() - allocationsBefore;
+
+    return true;
+}
+
+// Removes numSeams horizontal seams from an image whose energy matrix is up to date
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::removeHorizontalSeams(Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix,
+                                                          Image<Energy> &cEnergyMatrix, std::vector<int> &seam, const int &numSeams)
+{
+    if (batchSize > 1)
+    {
+        this->horizCumulativeEnergy(energyMatrix, cEnergyMatrix);
+
+        for (auto remaining = numSeams; remaining > 0;)
+        {
+            remaining -= this->removeHorizontalSeamBatch(imageMatrix, energyMatrix, cEnergyMatrix,
+                                                         std::min(batchSize, remaining));
+
+            this->calculateEnergyMatrix(imageMatrix, energyMatrix);
+            if (remaining > 0)
+                this->horizCumulativeEnergy(energyMatrix, cEnergyMatrix);
+        }
+    }
+    else if (compactDp)
+    {
+        for (auto j = 0; j < numSeams; ++j)
+        {
+            this->removeCompactSeam(imageMatrix, energyMatrix, seam, false);
+            totalRemovedEnergy += this->seamEnergy(energyMatrix, seam, false);
+
+            this->updateHorizEnergyMatrix(imageMatrix, energyMatrix, seam);
+        }
+    }
+    else
+    {
+        this->horizCumulativeEnergy(energyMatrix, cEnergyMatrix);
+
+        for (auto j = 0; j < numSeams; ++j)
+        {
+            this->removeHorizontalSeam(imageMatrix, cEnergyMatrix, seam);
+            totalRemovedEnergy += this->seamEnergy(energyMatrix, seam, false);
+
+            this->updateHorizEnergyMatrix(imageMatrix, energyMatrix, seam);
+            this->updateHorizCumulativeEnergy(energyMatrix, cEnergyMatrix, seam);
+        }
+    }
+}
+
+// Removes numSeams vertical seams exactly as one at a time removal does, recording in seamIndexMap the
+// seam that took each pixel of the original image
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::buildSeamIndexMap(Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix,
+                                                      Image<Energy> &cEnergyMatrix, std::vector<int> &seam, const int &numSeams)
+{
+    // Original column of every pixel still in the image, shifted along with it
+    originalColumns.reshape(imageMatrix.width, imageMatrix.height);
+
+    for (auto i = 0; i < originalColumns.height; ++i)
+        std::iota(originalColumns.row(i), originalColumns.row(i) + originalColumns.width, 0);
+
+    // Pixels no seam removes keep numSeams, so they survive every retargeted width
+    seamIndexMap.reshape(imageMatrix.width, imageMatrix.height);
+
+    for (auto i = 0; i < seamIndexMap.height; ++i)
+        std::fill(seamIndexMap.row(i), seamIndexMap.row(i) + seamIndexMap.width, numSeams);
+
+    this->calculateEnergyMatrix(imageMatrix, energyMatrix);
+    this->vertCumulativeEnergy(energyMatrix, cEnergyMatrix);
+
+    totalRemovedEnergy = 0;
+    const std::uint64_t allocationsBefore = allocationCounter::count();
+
+    for (auto n = 0; n < numSeams; ++n)
+    {
+        this->removeVerticalSeam(imageMatrix, cEnergyMatrix, seam);
+        totalRemovedEnergy += this->seamEnergy(energyMatrix, seam, true);
+
+        for (auto i = 0; i < originalColumns.height; ++i)
+        {
+            seamIndexMap.at(i, originalColumns.at(i, seam[i])) = n;
+            originalColumns.shiftOutPixel(i, seam[i]);
+        }
+        originalColumns.width--;
+
+        this->updateVertEnergyMatrix(imageMatrix, energyMatrix, seam);
+        this->updateVertCumulativeEnergy(energyMatrix, cEnergyMatrix, seam);
+    }
+
+    loopAllocations += allocationCounter::count() - allocationsBefore;
+}
+
+// Gathers the pixels of the original image that survive the first numSeams seams of a seam index map
+template <typename PixelT, int Channels>
+template <typename IndexT>
+void ImageCarver<PixelT, Channels>::retargetWidth(const Image<PixelT> &original, const IndexT *seamIndices,
+                                                  const std::size_t &indexStride,
+                                                  const int &numSeams, Image<PixelT> &imageMatrix)
+{
+    imageMatrix.channels = Channels;
+    imageMatrix.reshape(original.width - numSeams, original.height);
+
+    const int step = original.pixelStep();
+    const IndexT firstKept = static_cast<IndexT>(numSeams);
+
+    for (auto k = 0; k < (planarLayout ? Channels : 1); ++k)
+    {
+        for (auto i = 0; i < original.height; ++i)
+        {
+            const PixelT *from = original.row(i) + k * original.channelStep();
+            PixelT *to = imageMatrix.row(i) + k * imageMatrix.channelStep();
+            const IndexT *order = seamIndices + i * indexStride;
+
+            for (auto j = 0; j < original.width; ++j)
+            {
+                if (order[j] < firstKept)
+                    continue;
+
+                for (auto n = 0; n < step; ++n)
+                    to[n] = from[j * step + n];
+                to += step;
+            }
+        }
+    }
+}
+
+// Hashes the samples of an image together with everything else the seams depend on
+template <typename PixelT, int Channels>
+std::uint64_t ImageCarver<PixelT, Channels>::seamMapKey(const Image<PixelT> &imageMatrix)
+{
+    const std::uint32_t parameters[] = {SeamMapCache::formatVersion, static_cast<std::uint32_t>(imageMatrix.width),
+                                        static_cast<std::uint32_t>(imageMatrix.height),
+                                        static_cast<std::uint32_t>(Channels),
+                                        static_cast<std::uint32_t>(sizeof(PixelT))};
+    std::uint64_t key = SeamMapCache::hash(parameters, sizeof(parameters));
+
+    // Samples are hashed in interleaved order, so both layouts share entries
+    sampleRow.resize(static_cast<std::size_t>(imageMatrix.width) * Channels);
+
+    for (auto i = 0; i < imageMatrix.height; ++i)
+    {
+        imageMatrix.getRow(i, sampleRow.data());
+        key = SeamMapCache::hash(sampleRow.data(), sampleRow.size() * sizeof(PixelT), key);
+    }
+
+    return key;
+}
+
+// Reads in PGM/PPM pixel data
+template <typename PixelT, int Channels>
+bool ImageCarver<PixelT, Channels>::readPixels(const MappedFile &file, const pgmData &imageData,
+                                               Image<PixelT> &imageArray)
+{
+    imageArray.channels = Channels;
+    imageArray.reshape(imageData.columns, imageData.rows);
+    const char *pos = file.data() + imageData.rasterOffset;
+
+    return this->readRows(pos, file.data() + file.size(), imageData, imageArray);
+}
+
+// Decodes as many rows as imageArray holds, starting at pos and leaving it after the last one
+template <typename PixelT, int Channels>
+bool ImageCarver<PixelT, Channels>::readRows(const char *&pos, const char *end, const pgmData &imageData,
+                                             Image<PixelT> &imageArray)
+{
+    const int rowSamples = imageArray.width * Channels;
+
+    // Interleaved rows are filled in place, planar images are scattered from a scratch row
+    if constexpr (planarLayout)
+        sampleRow.resize(rowSamples);
+
+    if (imageData.binary)
+    {
+        for (auto i = 0; i < imageArray.height; ++i)
+        {
+            PixelT *row = planarLayout ? sampleRow.data() : imageArray.row(i);
+            const unsigned char *rowBytes = reinterpret_cast<const unsigned char *>(pos);
+            pos += static_cast<std::size_t>(rowSamples) * sizeof(PixelT);
+
+            // 8-bit rows are copied straight out of the mapping, 16-bit samples are big-endian
+            if constexpr (sizeof(PixelT) == 1)
+                std::memcpy(row, rowBytes, rowSamples);
+            else
+                for (auto j = 0; j < rowSamples; ++j)
+                    row[j] = static_cast<PixelT>(rowBytes[2 * j] << 8 | rowBytes[2 * j + 1]);
+
+            if constexpr (planarLayout)
+                imageArray.setRow(i, row);
+        }
+
+        return true;
+    }
+
+    // ASCII rasters are tokenized in place over the mapping, without going through iostreams
+    unsigned int value;
+
+    for (auto i = 0; i < imageArray.height; ++i)
+    {
+        PixelT *row = planarLayout ? sampleRow.data() : imageArray.row(i);
+
+        for (auto j = 0; j < rowSamples; ++j)
+        {
+            skipSeparators(pos, end);
+
+            auto result = std::from_chars(pos, end, value);
+            if (result.ec != std::errc() || value > static_cast<unsigned int>(imageData.maxValue))
+                return false;
+
+            row[j] = static_cast<PixelT>(value);
+            pos = result.ptr;
+        }
+
+        if constexpr (planarLayout)
+            imageArray.setRow(i, row);
+    }
+
+    return true;
+}
+
+// Output PGM/PPM to a new file in the same encoding as the input
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::writeImage(const std::string &fileName, const pgmData &imageData,
+                                               const Image<PixelT> &image,
+                                               const int &lineLength)
+{
+    std::ofstream imageProcessed;
+    imageProcessed.open(fileName, std::ios::binary);
+
+    // Add header info
+    imageProcessed << imageData.version << '\n';
+    if (!imageData.comment.empty())
+        imageProcessed << imageData.comment << '\n';
+    imageProcessed << image.width << ' ' << image.height << '\n';
+    imageProcessed << imageData.maxValue << '\n';
+
+    const int rowSamples = image.width * Channels;
+
+    // Planar images are gathered into interleaved order one row at a time
+    if constexpr (planarLayout)
+        sampleRow.resize(rowSamples);
+
+    // Add pixels
+    if (imageData.binary)
+    {
+        byteRow.resize(rowSamples * sizeof(PixelT));
+
+        for (auto i = 0; i < image.height; ++i)
+        {
+            const PixelT *row = image.row(i);
+
+            if constexpr (planarLayout)
+            {
+                image.getRow(i, sampleRow.data());
+                row = sampleRow.data();
+            }
+
+            if constexpr (sizeof(PixelT) == 1)
+            {
+                imageProcessed.write(reinterpret_cast<const char *>(row), rowSamples);
+                continue;
+            }
+
+            for (auto j = 0; j < rowSamples; ++j)
+            {
+                byteRow[2 * j] = static_cast<unsigned char>(row[j] >> 8);
+                byteRow[2 * j + 1] = static_cast<unsigned char>(row[j]);
+            }
+
+            imageProcessed.write(reinterpret_cast<const char *>(byteRow.data()), byteRow.size());
+        }
+    }
+    else
+    {
+        // Samples are formatted straight into a large buffer that is flushed only when nearly full.
+        // Each sample takes at most 5 digits plus one separator
+        const std::size_t flushMargin = 8;
+        outputBuffer.resize(1 << 20);
+        char *out = outputBuffer.data();
+        char *bufferEnd = outputBuffer.data() + outputBuffer.size();
+
+        for (auto i = 0; i < image.height; ++i)
+        {
+            const PixelT *row = image.row(i);
+
+            if constexpr (planarLayout)
+            {
+                image.getRow(i, sampleRow.data());
+                row = sampleRow.data();
+            }
+
+            int currentLength = 0;
+
+            for (auto j = 0; j < rowSamples; ++j)
+            {
+                // Digits go one past the separator, which becomes a newline if the line would get too long
+                char *digitsEnd = std::to_chars(out + 1, bufferEnd, row[j]).ptr;
+                int numDigits = digitsEnd - out - 1;
+
+                if (currentLength == 0)
+                {
+                    std::memmove(out, out + 1, numDigits);
+                    digitsEnd--;
+                    currentLength = numDigits;
+                }
+                else if (lineLength > 0 && currentLength + 1 + numDigits > lineLength)
+                {
+                    *out = '\n';
+                    currentLength = numDigits;
+                }
+                else
+                {
+                    *out = ' ';
+                    currentLength += 1 + numDigits;
+                }
+
+                out = digitsEnd;
+
+                if (static_cast<std::size_t>(bufferEnd - out) < flushMargin)
+                {
+                    imageProcessed.write(outputBuffer.data(), out - outputBuffer.data());
+                    out = outputBuffer.data();
+                }
+            }
+
+            // Every image row starts on a new line
+            *out++ = '\n';
+        }
+
+        imageProcessed.write(outputBuffer.data(), out - outputBuffer.data());
+    }
+
+    imageProcessed.close();
+}
+
+// Calculate the energy of a single pixel from the pixels around it
+template <typename PixelT, int Channels>
+inline Energy ImageCarver<PixelT, Channels>::calculatePixelEnergy(const Image<PixelT> &imageMatrix, const int &i,
+                                                                  const int &j)
+{
+    const PixelT *upRow = imageMatrix.row(i == 0 ? i : i - 1);
+    const PixelT *downRow = imageMatrix.row(i == (imageMatrix.height - 1) ? i : i + 1);
+
+    return energyKernels::pixelEnergy(upRow, imageMatrix.row(i), downRow, j, imageMatrix.width, Channels,
+                                      imageMatrix.channelStep());
+}
+
+// Calculate the energy matrix of an image
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::calculateEnergyMatrix(const Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix)
+{
+    const int numRows = imageMatrix.height;
+
+    energyMatrix.reshape(imageMatrix.width, numRows);
+
+    // Top and bottom rows stand in for their own missing neighbour
+    auto energyRows = [&](const int &rowStart, const int &rowEnd) {
+        for (auto i = rowStart; i < rowEnd; ++i)
+        {
+            const PixelT *upRow = imageMatrix.row(i == 0 ? i : i - 1);
+            const PixelT *downRow = imageMatrix.row(i == (numRows - 1) ? i : i + 1);
+
+            energyKernels::energyRow(upRow, imageMatrix.row(i), downRow, energyMatrix.row(i), imageMatrix.width,
+                                     Channels, imageMatrix.channelStep());
+        }
+    };
+
+    // Rows are independent, so large images hand every thread a band of them
+    ThreadPool &workers = this->threadPool();
+
+    if (workers.size() <= 1 || static_cast<std::int64_t>(imageMatrix.width) * numRows < minParallelEnergy)
+    {
+        energyRows(0, numRows);
+        return;
+    }
+
+    workers.run([&](int index) { energyRows(numRows * index / workers.size(), numRows * (index + 1) / workers.size()); });
+}
+
+// Updates the energy matrix after a vertical seam has been removed from the image
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::updateVertEnergyMatrix(const Image<PixelT> &imageMatrix,
+                                                           Image<Energy> &energyMatrix, const std::vector<int> &seam)
+{
+    const int numCols = imageMatrix.width;
+
+    for (auto i = 0; i < imageMatrix.height; ++i)
+    {
+        // Drop the removed pixel's energy the same way the pixel itself was dropped
+        Energy *energyRow = energyMatrix.row(i);
+        std::copy(energyRow + seam[i] + 1, energyRow + numCols + 1, energyRow + seam[i]);
+
+        // Only the pixels now on either side of the seam gained a new left/right neighbour, and
+        // since adjacent seam columns differ by at most one, the pixels whose above/below
+        // neighbour changed fall in the same two columns
+        const int first = std::max(seam[i] - 1, 0);
+        const int last = std::min(seam[i], numCols - 1);
+
+        for (auto j = first; j <= last; ++j)
+        {
+            energyRow[j] = this->calculatePixelEnergy(imageMatrix, i, j);
+        }
+    }
+
+    energyMatrix.width = numCols;
+}
+
+// Updates the energy matrix after a horizontal seam has been removed from the image
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::updateHorizEnergyMatrix(const Image<PixelT> &imageMatrix,
+                                                            Image<Energy> &energyMatrix, const std::vector<int> &seam)
+{
+    const int numRows = imageMatrix.height;
+
+    // Drop the removed pixels' energies the same way the pixels themselves were dropped
+    energyMatrix.shiftOutHorizontalSeam(seam);
+
+    // Same band as the vertical case, turned on its side
+    for (auto j = 0; j < imageMatrix.width; ++j)
+    {
+        const int first = std::max(seam[j] - 1, 0);
+        const int last = std::min(seam[j], numRows - 1);
+
+        for (auto i = first; i <= last; ++i)
+        {
+            energyMatrix.at(i, j) = this->calculatePixelEnergy(imageMatrix, i, j);
+        }
+    }
+}
+
+// Removes the lowest energy vertical seam
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::removeVerticalSeam(Image<PixelT> &imageMatrix, const Image<Energy> &cEnergyMatrix,
+                                                       std::vector<int> &seam)
+{
+    this->traceVerticalSeam(cEnergyMatrix, seam, 0, cEnergyMatrix.width);
+
+    // Remove lowest cumulative energy pixels by shifting pixels to their right to the left one
+    for (auto i = 0; i < imageMatrix.height; ++i)
+        imageMatrix.shiftOutPixel(i, seam[i]);
+
+    imageMatrix.width--;
+}
+
+// Removes a batch of vertical seams, every row losing one pixel per seam in a single pass
+template <typename PixelT, int Channels>
+int ImageCarver<PixelT, Channels>::removeVerticalSeamBatch(Image<PixelT> &imageMatrix,
+                                                           const Image<Energy> &energyMatrix,
+                                                           const Image<Energy> &cEnergyMatrix, const int &maxSeams)
+{
+    const int found = this->traceSeamBatch(energyMatrix, cEnergyMatrix, true, maxSeams);
+
+    imageMatrix.removeMaskedColumns(seamMask, found);
+
+    return found;
+}
+
+// Removes a batch of horizontal seams, every column losing one pixel per seam in a single pass
+template <typename PixelT, int Channels>
+int ImageCarver<PixelT, Channels>::removeHorizontalSeamBatch(Image<PixelT> &imageMatrix,
+                                                             const Image<Energy> &energyMatrix,
+                                                             const Image<Energy> &cEnergyMatrix, const int &maxSeams)
+{
+    const int found = this->traceSeamBatch(energyMatrix, cEnergyMatrix, false, maxSeams);
+
+    imageMatrix.removeMaskedRows(seamMask, found, removedAbove);
+
+    return found;
+}
+
+// Removes vertical seams while leaving the pixels where they are until the next compaction
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::removeVerticalSeamsDeferred(Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix,
+                                                                Image<Energy> &cEnergyMatrix, std::vector<int> &seam, const int &numSeams)
+{
+    const int numRows = imageMatrix.height;
+
+    // Every pixel starts out in its own column
+    columnMap.reshape(imageMatrix.width, numRows);
+
+    for (auto i = 0; i < numRows; ++i)
+        std::iota(columnMap.row(i), columnMap.row(i) + columnMap.width, 0);
+
+    for (auto n = 0; n < numSeams; ++n)
+    {
+        this->findMappedVerticalSeam(cEnergyMatrix, seam);
+
+        // Only the map entries move, the pixels and their energies stay in the buffers
+        for (auto i = 0; i < numRows; ++i)
+        {
+            totalRemovedEnergy += energyMatrix.row(i)[columnMap.row(i)[seam[i]]];
+            columnMap.shiftOutPixel(i, seam[i]);
+        }
+
+        columnMap.width--;
+
+        this->updateMappedVertEnergyMatrix(imageMatrix, energyMatrix, seam);
+        this->updateMappedVertCumulativeEnergy(energyMatrix, cEnergyMatrix, seam);
+
+        if (n == numSeams - 1 || (compactInterval > 0 && (n + 1) % compactInterval == 0))
+            this->compactColumns(imageMatrix, energyMatrix, cEnergyMatrix);
+    }
+}
+
+// Recomputes the energy of the pixels bordering a seam that was dropped from the column map
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::updateMappedVertEnergyMatrix(const Image<PixelT> &imageMatrix,
+                                                                 Image<Energy> &energyMatrix,
+                                                                 const std::vector<int> &seam)
+{
+    const int numCols = columnMap.width;
+    const int numRows = columnMap.height;
+    const int pixelStep = imageMatrix.pixelStep();
+    const int channelStep = imageMatrix.channelStep();
+
+    for (auto i = 0; i < numRows; ++i)
+    {
+        const int up = i == 0 ? i : i - 1;
+        const int down = i == (numRows - 1) ? i : i + 1;
+        const int *map = columnMap.row(i);
+        const int *upMap = columnMap.row(up);
+        const int *downMap = columnMap.row(down);
+        const PixelT *row = imageMatrix.row(i);
+
+        // Nothing has streamed through these rows since the last compaction, so the map entries and
+        // then the pixels a few rows further down the seam are requested ahead of time
+        if (i + 8 < numRows)
+            prefetch(columnMap.row(i + 8) + seam[i + 8]);
+        if (i + 4 < numRows)
+        {
+            const int column = columnMap.row(i + 4)[seam[i + 4]];
+            prefetch(imageMatrix.row(i + 4) + column * pixelStep);
+            prefetch(energyMatrix.row(i + 4) + column);
+        }
+
+        // Same two columns as updateVertEnergyMatrix, with every neighbour looked up in the map
+        const int first = std::max(seam[i] - 1, 0);
+        const int last = std::min(seam[i], numCols - 1);
+
+        for (auto j = first; j <= last; ++j)
+        {
+            const PixelT *left = row + map[j == 0 ? j : j - 1] * pixelStep;
+            const PixelT *right = row + map[j == (numCols - 1) ? j : j + 1] * pixelStep;
+
+            energyMatrix.row(i)[map[j]] =
+                energyKernels::pixelEnergy(row + map[j] * pixelStep, imageMatrix.row(up) + upMap[j] * pixelStep,
+                                           imageMatrix.row(down) + downMap[j] * pixelStep, left, right, Channels,
+                                           channelStep);
+        }
+    }
+}
+
+// Moves every remaining pixel, energy and cumulative energy to the column the map gives it
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::compactColumns(Image<PixelT> &imageMatrix, Image<Energy> &energyMatrix,
+                                                   Image<Energy> &cEnergyMatrix)
+{
+    const int numCols = columnMap.width;
+
+    for (auto i = 0; i < columnMap.height; ++i)
+    {
+        int *map = columnMap.row(i);
+
+        imageMatrix.gatherColumns(i, map, numCols);
+        energyMatrix.gatherColumns(i, map, numCols);
+        cEnergyMatrix.gatherColumns(i, map, numCols);
+
+        std::iota(map, map + numCols, 0);
+    }
+
+    imageMatrix.width = numCols;
+    energyMatrix.width = numCols;
+    cEnergyMatrix.width = numCols;
+}
+
+// Finds the lowest energy seam with the compact DP and removes it, following only the direction map back
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::removeCompactSeam(Image<PixelT> &imageMatrix, const Image<Energy> &energyMatrix,
+                                                      std::vector<int> &seam,
+                                                      const bool &vertical)
+{
+    const int numLines = vertical ? imageMatrix.height : imageMatrix.width;
+    int index = this->compactCumulativeEnergy(energyMatrix, vertical);
+
+    seam.resize(numLines);
+
+    for (auto line = numLines - 1; line >= 0; --line)
+    {
+        seam[line] = index;
+
+        if (line > 0)
+            index += ((directionMap.row(line)[index >> 2] >> (2 * (index & 3))) & 3) - 1;
+    }
+
+    if (vertical)
+    {
+        for (auto i = 0; i < numLines; ++i)
+            imageMatrix.shiftOutPixel(i, seam[i]);
+        imageMatrix.width--;
+    }
+    else
+        imageMatrix.shiftOutHorizontalSeam(seam);
+}
+
+// Carves an image whose pixels live in a mapped scratch file rather than in memory. Horizontal seams are
+// removed as vertical seams of the transposed image, which finds the same seams
+template <typename PixelT, int Channels>
+int ImageCarver<PixelT, Channels>::carveOutOfCore(const MappedFile &file, pgmData &imageData, char *argv[])
+{
+    const std::vector<int> verticalSeams = parseSeamCounts(argv[2]);
+    const int numVertical = verticalSeams[0];
+    const int numHorizontal = std::max(0, atoi(argv[3]));
+    const std::string newFileName = this->outputFileName(argv[1], argv[2], argv[3], Channels);
+    const std::size_t directoryEnd = newFileName.find_last_of("/\\");
+    const std::string outputDirectory = directoryEnd == std::string::npos ? "." : newFileName.substr(0, std::max<std::size_t>(directoryEnd, 1));
+
+    if (verticalSeams.size() > 1)
+    {
+        std::cerr << "--memory-budget takes a single vertical seam count" << std::endl;
+        return 1;
+    }
+
+    // Both passes must fit, the horizontal one running over the narrowed image turned on its side
+    const std::uint64_t verticalBytes = this->checkpointedBytes(imageData.columns, imageData.rows);
+    const std::uint64_t horizontalBytes =
+        numHorizontal > 0 ? this->checkpointedBytes(imageData.rows, imageData.columns - numVertical) : 0;
+    const std::uint64_t neededBytes = std::max(verticalBytes, horizontalBytes);
+
+    if (neededBytes > memoryBudget)
+    {
+        std::cerr << "A memory budget of at least " << ((neededBytes + (1 << 20) - 1) >> 20) << " MB is needed for "
+             << argv[1] << std::endl;
+        return 1;
+    }
+
+    const std::size_t numSamples = static_cast<std::size_t>(imageData.columns) * imageData.rows * Channels;
+    MappedScratchFile pixelFile(outputDirectory, numSamples * sizeof(PixelT));
+
+    if (!pixelFile.data())
+    {
+        std::cerr << "Could not create a scratch file next to " << newFileName << " or in the temporary directory"
+                  << std::endl;
+        return 1;
+    }
+
+    Image<PixelT> pixels = Image<PixelT>::mapped(reinterpret_cast<PixelT *>(pixelFile.data()), imageData.columns,
+                                                 imageData.rows, Channels);
+    const char *pos = file.data() + imageData.rasterOffset;
+
+    if (!this->readRows(pos, file.data() + file.size(), imageData, pixels))
+    {
+        std::cerr << argv[1] << " has a truncated or malformed raster" << std::endl;
+        return 1;
+    }
+
+    totalRemovedEnergy = 0;
+    loopAllocations = 0;
+    this->removeVerticalSeamsCheckpointed(pixels, currentSeam, numVertical);
+
+    if (numHorizontal > 0)
+    {
+        MappedScratchFile transposedFile(outputDirectory, numSamples * sizeof(PixelT));
+
+        if (!transposedFile.data())
+        {
+            std::cerr << "Could not create a scratch file next to " << newFileName << " or in the temporary directory"
+                      << std::endl;
+            return 1;
+        }
+
+        Image<PixelT> transposed = Image<PixelT>::mapped(reinterpret_cast<PixelT *>(transposedFile.data()), pixels.height,
+                                                         pixels.width, Channels);
+
+        transposeImage(pixels, transposed);
+        this->removeVerticalSeamsCheckpointed(transposed, currentSeam, numHorizontal);
+        transposeImage(transposed, pixels);
+    }
+
+    imageData.columns = pixels.width;
+    imageData.rows = pixels.height;
+    this->writeImage(newFileName, imageData, pixels);
+    if (!quiet)
+        std::cout << "\nNew image generated" << std::endl;
+
+    return 0;
+}
+
+// Removes numSeams vertical seams with a DP that keeps only every interval-th cumulative energy row.
+// Backtracking walks the segments between checkpoints from the bottom up, recomputing each segment from
+// the checkpoint above it to get its parent directions, and only then are the seam's pixels removed
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::removeVerticalSeamsCheckpointed(Image<PixelT> &imageMatrix,
+                                                                    std::vector<int> &seam, const int &numSeams)
+{
+    const int numRows = imageMatrix.height;
+
+    // Energy of row i, computed from the pixels whenever it is needed
+    auto energyOfRow = [&](const int &i) {
+        const PixelT *upRow = imageMatrix.row(i == 0 ? i : i - 1);
+        const PixelT *downRow = imageMatrix.row(i == (numRows - 1) ? i : i + 1);
+
+        energyKernels::energyRow(upRow, imageMatrix.row(i), downRow, energyLine.data(), imageMatrix.width,
+                                 Channels, imageMatrix.channelStep());
+        return energyLine.data();
+    };
+
+    // Buffers are grown for every width up front. The interval hardly moves as the image narrows, but
+    // the number of checkpoints can still go up by one
+    const int widestInterval = this->checkpointInterval(imageMatrix.width, numRows);
+
+    seam.resize(numRows);
+    checkpoints.reshape(imageMatrix.width, (numRows - 1) / std::max(widestInterval - 1, 1) + 2);
+    directionMap.reshape((imageMatrix.width + 3) / 4, widestInterval + 2);
+    energyLine.reserve(imageMatrix.width);
+    prevCumulativeLine.reserve(imageMatrix.width);
+    cumulativeLine.reserve(imageMatrix.width);
+
+    const std::uint64_t allocationsBefore = allocationCounter::count();
+
+    for (auto n = 0; n < numSeams; ++n)
+    {
+        const int numCols = imageMatrix.width;
+        const int interval = this->checkpointInterval(numCols, numRows);
+        const int numCheckpoints = (numRows - 1) / interval + 1;
+
+        checkpoints.reshape(numCols, numCheckpoints);
+        directionMap.reshape((numCols + 3) / 4, interval + 1);
+        energyLine.resize(numCols);
+        prevCumulativeLine.resize(numCols);
+        cumulativeLine.resize(numCols);
+
+        // Forward pass, keeping every interval-th row
+        const Energy *firstRow = energyOfRow(0);
+        std::copy(firstRow, firstRow + numCols, prevCumulativeLine.begin());
+        std::copy(firstRow, firstRow + numCols, checkpoints.row(0));
+
+        for (auto i = 1; i < numRows; ++i)
+        {
+            energyKernels::cumulativeRow(energyOfRow(i), prevCumulativeLine.data(), cumulativeLine.data(), 0, numCols,
+                                         numCols);
+            prevCumulativeLine.swap(cumulativeLine);
+
+            if (i % interval == 0)
+                std::copy(prevCumulativeLine.begin(), prevCumulativeLine.end(), checkpoints.row(i / interval));
+        }
+
+        int index = static_cast<int>(std::min_element(prevCumulativeLine.begin(), prevCumulativeLine.end()) -
+                                     prevCumulativeLine.begin());
+
+        // Backward pass, segment by segment from the bottom up
+        for (auto c = numCheckpoints - 1; c >= 0; --c)
+        {
+            const int first = c * interval;
+            const int last = std::min(first + interval, numRows - 1);
+
+            std::copy(checkpoints.row(c), checkpoints.row(c) + numCols, prevCumulativeLine.begin());
+
+            for (auto i = first + 1; i <= last; ++i)
+            {
+                energyKernels::parentDirections(prevCumulativeLine.data(), directionMap.row(i - first), numCols);
+                energyKernels::cumulativeRow(energyOfRow(i), prevCumulativeLine.data(), cumulativeLine.data(), 0,
+                                             numCols, numCols);
+                prevCumulativeLine.swap(cumulativeLine);
+            }
+
+            for (auto i = last; i > first; --i)
+            {
+                seam[i] = index;
+                index += ((directionMap.row(i - first)[index >> 2] >> (2 * (index & 3))) & 3) - 1;
+            }
+        }
+
+        seam[0] = index;
+
+        // Energies are taken before any row moves, since each depends on the rows above and below
+        for (auto i = 0; i < numRows; ++i)
+            totalRemovedEnergy += this->calculatePixelEnergy(imageMatrix, i, seam[i]);
+
+        for (auto i = 0; i < numRows; ++i)
+            imageMatrix.shiftOutPixel(i, seam[i]);
+        imageMatrix.width--;
+    }
+
+    loopAllocations += allocationCounter::count() - allocationsBefore;
+}
+
+// Removes the lowest energy horizontal seam
+template <typename PixelT, int Channels>
+void ImageCarver<PixelT, Channels>::removeHorizontalSeam(Image<PixelT> &imageMatrix,
+                                                         const Image<Energy> &cEnergyMatrix, std::vector<int> &seam)
+{
+    this->traceHorizontalSeam(cEnergyMatrix, seam);
+
+    // Remove the seam by shifting the pixels below it up one row
+    imageMatrix.shiftOutHorizontalSeam(seam);
+}
+
+#endif
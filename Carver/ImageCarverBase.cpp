@@ -0,0 +1,1184 @@
+/*
+    ImageCarverBase.cpp
+
+    Implementation file for the parts of the carver that do not depend on the pixel type.
+*/
+
+#include "ImageCarverBase.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+
+using std::cerr;
+using std::endl;
+using std::min;
+using std::string;
+using std::vector;
+using energyKernels::saturatingAdd;
+
+ImageCarverBase::ImageCarverBase()
+{
+    data.version = "";
+    data.comment = "";
+    data.columns = 0;
+    data.rows = 0;
+    data.maxValue = 0;
+    data.channels = 0;
+    data.binary = false;
+    data.rasterOffset = 0;
+
+    numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    schedule = Schedule::Tiles;
+    compactInterval = -1;
+    batchSize = 1;
+    compactDp = false;
+    memoryBudget = 0;
+    pyramidLevels = 0;
+    bandWidth = 4;
+    cacheLimit = defaultCacheLimit;
+    totalRemovedEnergy = 0;
+    loopAllocations = 0;
+    lentPool = nullptr;
+    quiet = false;
+}
+
+void ImageCarverBase::setThreads(const int &threads)
+{
+    numThreads = std::max(1, threads);
+}
+
+void ImageCarverBase::setSchedule(const Schedule &dpSchedule)
+{
+    schedule = dpSchedule;
+}
+
+void ImageCarverBase::setDeferredRemoval(const int &interval)
+{
+    compactInterval = interval;
+}
+
+void ImageCarverBase::setBatchSize(const int &seams)
+{
+    batchSize = std::max(1, seams);
+}
+
+void ImageCarverBase::setCompactDp(const bool &enabled)
+{
+    compactDp = enabled;
+}
+
+void ImageCarverBase::setPyramidSearch(const int &levels, const int &band)
+{
+    pyramidLevels = std::max(0, levels);
+    bandWidth = std::max(1, band);
+}
+
+void ImageCarverBase::setMemoryBudget(const std::uint64_t &maxBytes)
+{
+    memoryBudget = maxBytes;
+}
+
+void ImageCarverBase::setSeamMapCache(const string &directory, const std::uint64_t &maxBytes)
+{
+    cacheDirectory = directory;
+    cacheLimit = maxBytes;
+}
+
+void ImageCarverBase::useThreadPool(ThreadPool *workers)
+{
+    lentPool = workers;
+}
+
+void ImageCarverBase::setQuiet(const bool &enabled)
+{
+    quiet = enabled;
+}
+
+std::uint64_t ImageCarverBase::removedEnergy() const
+{
+    return totalRemovedEnergy;
+}
+
+std::uint64_t ImageCarverBase::seamLoopAllocations() const
+{
+    return loopAllocations;
+}
+
+// Returns the lent thread pool if there is one, with every thread that joined it so far, otherwise the
+// carver's own, (re)creating it if the thread count changed
+ThreadPool &ImageCarverBase::threadPool()
+{
+    if (lentPool)
+    {
+        lentPool->admit();
+        return *lentPool;
+    }
+
+    if (!pool || pool->size() != numThreads)
+        pool = std::make_unique<ThreadPool>(numThreads);
+
+    return *pool;
+}
+
+// Grows the buffers of whichever seam loop the settings select to the sizes it reaches on a numCols x numRows
+// image, which only shrinks as seams go. Buffers shared by vertical and horizontal seams are grown for both
+void ImageCarverBase::reserveArena(const int &numCols, const int &numRows)
+{
+    const int longest = std::max(numCols, numRows);
+
+    this->threadPool();
+
+    pixelEnergy.reshape(numCols, numRows);
+    cumulativeEnergy.reshape(numCols, numRows);
+    currentSeam.reserve(longest);
+    removedAbove.reserve(numCols);
+
+    if (batchSize > 1)
+    {
+        seamMask.reshape(numCols, numRows);
+        seamStarts.reserve(longest);
+        return;
+    }
+
+    if (compactDp)
+    {
+        // Vertical seams use (numCols + 3) / 4 bytes a line over numRows lines and horizontal ones the
+        // transpose. A square on the longer side holds either, whichever comes first
+        directionMap.reshape((longest + 3) / 4, longest);
+        prevCumulativeLine.reserve(longest);
+        cumulativeLine.reserve(longest);
+        energyColumn.reserve(numRows);
+        return;
+    }
+
+    if (pyramidLevels > 0)
+    {
+        int levelCols = numCols;
+        int levelRows = numRows;
+
+        changedColumns.reserve(numRows);
+        coarseSeam.reserve(numRows);
+        bandStarts.reserve(numRows);
+        bandEnds.reserve(numRows);
+        pyramidEnergy.resize(pyramidLevels + 1);
+        pyramidCumulative.resize(pyramidLevels + 1);
+        pyramidChanges.resize(pyramidLevels + 1);
+
+        for (auto level = 1; level <= pyramidLevels; ++level)
+        {
+            if (levelCols < 2 * minPyramidSize || levelRows < 2 * minPyramidSize)
+                break;
+
+            levelCols = (levelCols + 1) / 2;
+            levelRows = (levelRows + 1) / 2;
+            pyramidEnergy[level].reshape(levelCols, levelRows);
+            pyramidCumulative[level].reshape(levelCols, levelRows);
+            pyramidChanges[level].reserve(levelRows);
+        }
+        return;
+    }
+
+    if (compactInterval >= 0)
+        columnMap.reshape(numCols, numRows);
+}
+
+// Splits a comma-separated list of seam counts such as "100,250,400"
+vector<int> ImageCarverBase::parseSeamCounts(const char *list)
+{
+    vector<int> counts;
+    const char *pos = list;
+    const char *end = list + std::strlen(list);
+
+    for (;;)
+    {
+        // Every entry must be a whole number running up to the next comma
+        const char *next = std::find(pos, end, ',');
+        int count = 0;
+        auto result = std::from_chars(pos, next, count);
+
+        if (result.ec != std::errc() || result.ptr != next)
+            return {};
+
+        counts.push_back(std::max(0, count));
+
+        if (next == end)
+            return counts;
+
+        pos = next + 1;
+    }
+}
+
+// Checks that every vertical seam count, together with the horizontal one, leaves at least one pixel
+bool ImageCarverBase::seamCountsFit(const char *verticalSeams, const char *horizontalSeams, const int &numCols,
+                                    const int &numRows)
+{
+    const int numHorizontal = std::max(0, atoi(horizontalSeams));
+
+    for (auto numVertical : parseSeamCounts(verticalSeams))
+    {
+        if (numVertical >= numCols || numHorizontal >= numRows)
+        {
+            cerr << "Cannot remove " << verticalSeams << " vertical and " << horizontalSeams << " horizontal seams from a "
+                 << numCols << "x" << numRows << " image" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Moves pos past whitespace and '#' comments, returning the start of the first comment skipped
+const char *ImageCarverBase::skipSeparators(const char *&pos, const char *end)
+{
+    const char *comment = nullptr;
+
+    while (pos < end && (isSeparator(*pos) || *pos == '#'))
+    {
+        if (*pos == '#')
+        {
+            if (!comment)
+                comment = pos;
+            pos = std::find(pos, end, '\n');
+        }
+        else
+            ++pos;
+    }
+
+    return comment;
+}
+
+// Prints the command line the carvers take
+void ImageCarverBase::printUsage(const char *program)
+{
+    cerr << "Usage: " << program << " <image> <vertical seams>[,...] <horizontal seams> [--threads=N]"
+         << " [--schedule=rows|tiles] [--deferred[=N]] [--batch=K] [--compact-dp]"
+         << " [--cache=DIR] [--cache-size=MB] [--memory-budget=MB]"
+         << " [--pyramid=L] [--band=B]" << endl;
+    cerr << "--memory-budget bounds the buffers of the checkpointed DP; the image itself is paged from scratch files"
+         << " by the OS and not counted" << endl;
+}
+
+// Applies the optional settings after the seam counts
+bool ImageCarverBase::parseOptions(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        printUsage(argv[0]);
+        return false;
+    }
+
+    if (parseSeamCounts(argv[2]).empty())
+    {
+        cerr << "Vertical seams must be a number or a comma-separated list of numbers, not \"" << argv[2] << "\"" << endl;
+        return false;
+    }
+
+    for (auto n = 4; n < argc; ++n)
+    {
+        string option = argv[n];
+
+        if (option.rfind("--threads=", 0) == 0)
+            this->setThreads(atoi(option.c_str() + 10));
+        else if (option == "--schedule=rows")
+            this->setSchedule(Schedule::Rows);
+        else if (option == "--schedule=tiles")
+            this->setSchedule(Schedule::Tiles);
+        else if (option == "--deferred")
+            this->setDeferredRemoval(0);
+        else if (option.rfind("--deferred=", 0) == 0)
+            this->setDeferredRemoval(std::max(0, atoi(option.c_str() + 11)));
+        else if (option.rfind("--batch=", 0) == 0)
+            this->setBatchSize(atoi(option.c_str() + 8));
+        else if (option == "--compact-dp")
+            this->setCompactDp(true);
+        else if (option.rfind("--pyramid=", 0) == 0)
+            this->setPyramidSearch(atoi(option.c_str() + 10), bandWidth);
+        else if (option.rfind("--band=", 0) == 0)
+            this->setPyramidSearch(pyramidLevels, atoi(option.c_str() + 7));
+        else if (option.rfind("--memory-budget=", 0) == 0)
+            this->setMemoryBudget(std::strtoull(option.c_str() + 16, nullptr, 10) << 20);
+        else if (option.rfind("--cache=", 0) == 0)
+            this->setSeamMapCache(option.substr(8), cacheLimit);
+        else if (option.rfind("--cache-size=", 0) == 0)
+            this->setSeamMapCache(cacheDirectory, std::strtoull(option.c_str() + 13, nullptr, 10) << 20);
+        else
+        {
+            cerr << "Unknown option " << option << endl;
+            return false;
+        }
+    }
+
+    if (const char *conflict = this->conflictingSettings())
+    {
+        cerr << conflict << endl;
+        printUsage(argv[0]);
+        return false;
+    }
+
+    // Lists of widths and the cache share a seam index map built from exact seams, which none of the modes apply to
+    if ((parseSeamCounts(argv[2]).size() > 1 || !cacheDirectory.empty()) && this->numModes() > 0)
+    {
+        cerr << "Several vertical seam counts or --cache cannot be combined with --batch, --compact-dp, --pyramid or "
+             << "--deferred" << endl;
+        printUsage(argv[0]);
+        return false;
+    }
+
+    return true;
+}
+
+int ImageCarverBase::numModes() const
+{
+    return (batchSize > 1) + compactDp + (pyramidLevels > 0) + (compactInterval >= 0);
+}
+
+// Finds settings that would each be dropped in favour of another
+const char *ImageCarverBase::conflictingSettings() const
+{
+    if (this->numModes() > 1)
+        return "Only one of --batch, --compact-dp, --pyramid and --deferred can be given";
+
+    // Out-of-core carving runs its own checkpointed DP, which none of the modes apply to
+    if (memoryBudget > 0 && this->numModes() > 0)
+        return "--memory-budget cannot be combined with --batch, --compact-dp, --pyramid or --deferred";
+
+    return nullptr;
+}
+
+// Builds the name of the output image, next to the input and with the extension matching its format
+string ImageCarverBase::outputFileName(const string &inputName, const string &verticalSeams,
+                                       const string &horizontalSeams,
+                                       const int &channels)
+{
+    string newFileName = inputName;
+    size_t extensionStart = newFileName.find_last_of('.');
+    size_t directoryEnd = newFileName.find_last_of("/\\");
+
+    if (extensionStart != string::npos && (directoryEnd == string::npos || extensionStart > directoryEnd))
+        newFileName.erase(extensionStart);
+
+    newFileName += "_processed_" + verticalSeams + "_" + horizontalSeams;
+    newFileName += channels == 1 ? ".pgm" : ".ppm";
+
+    return newFileName;
+}
+
+// Reads in PGM/PPM Header Data
+bool ImageCarverBase::readHeader(const MappedFile &file, pgmData &imageData)
+{
+    const char *pos = file.data();
+    const char *end = file.data() + file.size();
+
+    if (file.size() < 2 || pos[0] != 'P')
+        return false;
+
+    switch (pos[1])
+    {
+    case '2':
+    case '5':
+        imageData.channels = 1;
+        break;
+    case '3':
+    case '6':
+        imageData.channels = 3;
+        break;
+    default:
+        return false;
+    }
+
+    imageData.version = string(pos, 2);
+    imageData.comment = "";
+    imageData.binary = pos[1] == '5' || pos[1] == '6';
+    pos += 2;
+
+    // Width, height and maxValue, separated by whitespace and any number of comments
+    int fields[3];
+
+    for (auto n = 0; n < 3; ++n)
+    {
+        // Keep the first comment so it can be written back out
+        const char *comment = skipSeparators(pos, end);
+        if (comment && imageData.comment.empty())
+            imageData.comment.assign(comment, std::find(comment, end, '\n'));
+
+        auto result = std::from_chars(pos, end, fields[n]);
+        if (result.ec != std::errc())
+            return false;
+        pos = result.ptr;
+    }
+
+    // A single whitespace character separates the header from the raster
+    if (pos == end || !isSeparator(*pos))
+        return false;
+
+    imageData.columns = fields[0];
+    imageData.rows = fields[1];
+    imageData.maxValue = fields[2];
+    imageData.rasterOffset = pos + 1 - file.data();
+
+    if (imageData.columns <= 0 || imageData.rows <= 0 || imageData.maxValue <= 0 || imageData.maxValue > 65535)
+        return false;
+
+    // Binary rasters hold one byte per sample, or two big-endian bytes when maxValue is above 255
+    if (imageData.binary)
+    {
+        std::size_t sampleBytes = imageData.maxValue > 255 ? 2 : 1;
+        std::size_t rasterBytes = sampleBytes * imageData.channels * imageData.columns * imageData.rows;
+
+        if (file.size() - imageData.rasterOffset < rasterBytes)
+            return false;
+    }
+
+    return true;
+}
+
+// Determines the vertical cumulative energy of the image
+void ImageCarverBase::vertCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix)
+{
+    const int numCols = energyMatrix.width;
+
+    cEnergyMatrix.reshape(numCols, energyMatrix.height);
+
+    // Narrow images are not worth waking the pool for
+    if (this->threadPool().size() <= 1 || numCols < (schedule == Schedule::Tiles ? minTiledLength : minParallelLength))
+    {
+        this->vertCumulativeColumns(energyMatrix, cEnergyMatrix, 0, numCols, nullptr);
+        return;
+    }
+
+    if (schedule == Schedule::Tiles)
+    {
+        this->tiledCumulativeEnergy(energyMatrix.height, numCols, [&](const int &i, const int &first, const int &last) {
+            const Energy *energyRow = energyMatrix.row(i);
+            Energy *cRow = cEnergyMatrix.row(i);
+
+            if (i == 0)
+                std::copy(energyRow + first, energyRow + last, cRow + first);
+            else
+                energyKernels::cumulativeRow(energyRow, cRow - cEnergyMatrix.stride, cRow, first, last, numCols);
+        });
+        return;
+    }
+
+    // Each row only depends on the one above, so every thread takes a slice of columns and
+    // the threads meet at a barrier before moving on to the next row
+    ThreadPool &workers = this->threadPool();
+    SpinBarrier barrier(workers.size());
+
+    workers.run([&](int index) {
+        const int colStart = numCols * index / workers.size();
+        const int colEnd = numCols * (index + 1) / workers.size();
+        this->vertCumulativeColumns(energyMatrix, cEnergyMatrix, colStart, colEnd, &barrier);
+    });
+}
+
+// Determines the vertical cumulative energy of a slice of columns
+void ImageCarverBase::vertCumulativeColumns(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                                            const int &colStart,
+                                            const int &colEnd, SpinBarrier *barrier)
+{
+    const int numCols = energyMatrix.width;
+    const int numRows = energyMatrix.height;
+
+    // Loop through rows & columns
+    for (auto i = 0; i < numRows; ++i)
+    {
+        const Energy *energyRow = energyMatrix.row(i);
+        Energy *cRow = cEnergyMatrix.row(i);
+
+        // If top row
+        if (i == 0)
+            std::copy(energyRow + colStart, energyRow + colEnd, cRow + colStart);
+        else
+            energyKernels::cumulativeRow(energyRow, cEnergyMatrix.row(i - 1), cRow, colStart, colEnd, numCols);
+
+        if (barrier)
+            barrier->wait();
+    }
+}
+
+// Determines the horizontal cumulative energy of the image
+void ImageCarverBase::horizCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix)
+{
+    const int numRows = energyMatrix.height;
+
+    cEnergyMatrix.reshape(energyMatrix.width, numRows);
+
+    if (this->threadPool().size() <= 1 || numRows < (schedule == Schedule::Tiles ? minTiledLength : minParallelLength))
+    {
+        this->horizCumulativeRows(energyMatrix, cEnergyMatrix, 0, numRows, nullptr);
+        return;
+    }
+
+    if (schedule == Schedule::Tiles)
+    {
+        const int stride = cEnergyMatrix.stride;
+
+        // Lines of this DP are columns, indices along them are rows
+        this->tiledCumulativeEnergy(energyMatrix.width, numRows, [&](const int &j, const int &first, const int &last) {
+            for (auto i = first; i < last; ++i)
+            {
+                const Energy value = energyMatrix.at(i, j);
+                cEnergyMatrix.at(i, j) =
+                    j == 0 ? value : saturatingAdd(value, this->lowestParentEnergy(cEnergyMatrix.row(0) + (j - 1), i, numRows, stride));
+            }
+        });
+        return;
+    }
+
+    // Same as the vertical case with rows and columns swapped, each thread owning a band of rows
+    ThreadPool &workers = this->threadPool();
+    SpinBarrier barrier(workers.size());
+
+    workers.run([&](int index) {
+        const int rowStart = numRows * index / workers.size();
+        const int rowEnd = numRows * (index + 1) / workers.size();
+        this->horizCumulativeRows(energyMatrix, cEnergyMatrix, rowStart, rowEnd, &barrier);
+    });
+}
+
+// Determines the horizontal cumulative energy of a band of rows
+void ImageCarverBase::horizCumulativeRows(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                                          const int &rowStart,
+                                          const int &rowEnd, SpinBarrier *barrier)
+{
+    const int numCols = energyMatrix.width;
+    const int numRows = energyMatrix.height;
+    const int stride = cEnergyMatrix.stride;
+
+    // Loop through columns & rows
+    for (auto j = 0; j < numCols; ++j)
+    {
+        // If first column
+        if (j == 0)
+        {
+            for (auto i = rowStart; i < rowEnd; ++i)
+                cEnergyMatrix.at(i, j) = energyMatrix.at(i, j);
+        }
+        else
+        {
+            const Energy *prevColumn = cEnergyMatrix.row(0) + (j - 1);
+
+            for (auto i = rowStart; i < rowEnd; ++i)
+            {
+                cEnergyMatrix.at(i, j) = saturatingAdd(energyMatrix.at(i, j), this->lowestParentEnergy(prevColumn, i, numRows, stride));
+            }
+        }
+
+        if (barrier)
+            barrier->wait();
+    }
+}
+
+// Runs a three-point DP with trapezoid tiling. Lines are processed in bands; in each band every
+// thread first fills a trapezoid that narrows by one index per line, since those cells only need
+// values from its own block. After a barrier, the triangles left between neighbouring trapezoids
+// are filled, and a second barrier ends the band
+template <typename Span>
+void ImageCarverBase::tiledCumulativeEnergy(const int &numLines, const int &lineLength, Span span)
+{
+    ThreadPool &workers = this->threadPool();
+    const int numBlocks = workers.size();
+    SpinBarrier barrier(numBlocks);
+
+    // Triangles on neighbouring boundaries must not overlap, which bounds the band height by half a block
+    const int bandHeight = std::max(1, std::min(maxBandHeight, lineLength / numBlocks / 2));
+
+    workers.run([&](int index) {
+        const int blockStart = lineLength * index / numBlocks;
+        const int blockEnd = lineLength * (index + 1) / numBlocks;
+
+        for (auto bandStart = 0; bandStart < numLines; bandStart += bandHeight)
+        {
+            const int bandEnd = std::min(bandStart + bandHeight, numLines);
+
+            // Trapezoid, which does not need to narrow along the outer edges of the image
+            for (auto i = bandStart; i < bandEnd; ++i)
+            {
+                const int first = index == 0 ? 0 : blockStart + (i - bandStart);
+                const int last = index == numBlocks - 1 ? lineLength : blockEnd - (i - bandStart);
+
+                span(i, first, last);
+            }
+
+            barrier.wait();
+
+            // Triangle over the boundary with the next block
+            if (index < numBlocks - 1)
+            {
+                for (auto i = bandStart + 1; i < bandEnd; ++i)
+                    span(i, blockEnd - (i - bandStart), blockEnd + (i - bandStart));
+            }
+
+            barrier.wait();
+        }
+    });
+}
+
+// Updates the vertical cumulative energy after a vertical seam has been removed
+void ImageCarverBase::updateVertCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                                                 const vector<int> &seam)
+{
+    const int numCols = energyMatrix.width;
+    const int numRows = energyMatrix.height;
+
+    // Range of columns in the previous row whose cumulative energy actually changed
+    int changedFirst = numCols;
+    int changedLast = -1;
+
+    for (auto i = 0; i < numRows; ++i)
+    {
+        // Drop the removed pixel's entry so untouched values line up with their pixels again
+        const Energy *energyRow = energyMatrix.row(i);
+        Energy *cRow = cEnergyMatrix.row(i);
+        std::copy(cRow + seam[i] + 1, cRow + numCols + 1, cRow + seam[i]);
+
+        // Pixels next to the seam have a new energy or a new set of parents
+        int first = std::max(seam[i] - 2, 0);
+        int last = std::min(seam[i] + 1, numCols - 1);
+
+        // Pixels below a changed value may change too. Once a row reproduces its old values
+        // this range is empty and the cone collapses back onto the seam itself
+        if (changedFirst <= changedLast)
+        {
+            first = std::min(first, std::max(changedFirst - 1, 0));
+            last = std::max(last, std::min(changedLast + 1, numCols - 1));
+        }
+
+        changedFirst = numCols;
+        changedLast = -1;
+
+        for (auto j = first; j <= last; ++j)
+        {
+            Energy value = energyRow[j];
+
+            if (i > 0)
+                value = saturatingAdd(value, this->lowestParentEnergy(cEnergyMatrix.row(i - 1), j, numCols));
+
+            if (value != cRow[j])
+            {
+                cRow[j] = value;
+                changedFirst = std::min(changedFirst, j);
+                changedLast = j;
+            }
+        }
+    }
+
+    cEnergyMatrix.width = numCols;
+}
+
+// Updates the horizontal cumulative energy after a horizontal seam has been removed
+void ImageCarverBase::updateHorizCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                                                  const vector<int> &seam)
+{
+    const int numCols = energyMatrix.width;
+    const int numRows = energyMatrix.height;
+    const int stride = cEnergyMatrix.stride;
+
+    // Drop the removed pixels' entries so untouched values line up with their pixels again
+    cEnergyMatrix.shiftOutHorizontalSeam(seam);
+
+    // Range of rows in the previous column whose cumulative energy actually changed
+    int changedFirst = numRows;
+    int changedLast = -1;
+
+    for (auto j = 0; j < numCols; ++j)
+    {
+        // Same cone as the vertical case, spreading to the right instead of downwards
+        int first = std::max(seam[j] - 2, 0);
+        int last = std::min(seam[j] + 1, numRows - 1);
+
+        if (changedFirst <= changedLast)
+        {
+            first = std::min(first, std::max(changedFirst - 1, 0));
+            last = std::max(last, std::min(changedLast + 1, numRows - 1));
+        }
+
+        changedFirst = numRows;
+        changedLast = -1;
+
+        const Energy *energyColumn = energyMatrix.row(0) + j;
+        Energy *cColumn = cEnergyMatrix.row(0) + j;
+
+        for (auto i = first; i <= last; ++i)
+        {
+            Energy value = energyColumn[i * energyMatrix.stride];
+
+            if (j > 0)
+                value = saturatingAdd(value, this->lowestParentEnergy(cColumn - 1, i, numRows, stride));
+
+            if (value != cColumn[i * stride])
+            {
+                cColumn[i * stride] = value;
+                changedFirst = std::min(changedFirst, i);
+                changedLast = i;
+            }
+        }
+    }
+}
+
+// Finds a vertical seam on the coarsest level of an energy pyramid, then refines it one level at a time
+// within a band of columns around the seam of the level below
+void ImageCarverBase::findVerticalSeamPyramid(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                                              vector<int> &seam, const vector<int> &changedColumns)
+{
+    // Each level halves both sides of the one above it, stopping before a level gets too small to search
+    int numLevels = 0;
+
+    pyramidEnergy.resize(pyramidLevels + 1);
+    pyramidCumulative.resize(pyramidLevels + 1);
+    pyramidChanges.resize(pyramidLevels + 1);
+
+    for (const Image<Energy> *finer = &energyMatrix; numLevels < pyramidLevels; finer = &pyramidEnergy[numLevels])
+    {
+        if (finer->width < 2 * minPyramidSize || finer->height < 2 * minPyramidSize)
+            break;
+
+        const vector<int> &finerChanges = numLevels == 0 ? changedColumns : pyramidChanges[numLevels];
+        ++numLevels;
+        this->downsampleEnergy(*finer, pyramidEnergy[numLevels], finerChanges, pyramidChanges[numLevels]);
+    }
+
+    const int coarsest = numLevels;
+    const Image<Energy> &coarsestEnergy = coarsest == 0 ? energyMatrix : pyramidEnergy[coarsest];
+    Image<Energy> &coarsestCumulative = coarsest == 0 ? cEnergyMatrix : pyramidCumulative[coarsest];
+
+    this->vertCumulativeEnergy(coarsestEnergy, coarsestCumulative);
+    this->traceVerticalSeam(coarsestCumulative, seam, 0, coarsestCumulative.width);
+
+    for (auto level = coarsest - 1; level >= 0; --level)
+    {
+        coarseSeam.swap(seam);
+
+        if (level == 0)
+            this->bandedVertSeam(energyMatrix, cEnergyMatrix, coarseSeam, seam);
+        else
+            this->bandedVertSeam(pyramidEnergy[level], pyramidCumulative[level], coarseSeam, seam);
+    }
+}
+
+// Averages every 2 x 2 block of energies into one, starting each coarse row from the first block the
+// finer level changed in since the last call
+void ImageCarverBase::downsampleEnergy(const Image<Energy> &energyMatrix, Image<Energy> &coarseMatrix,
+                                       const vector<int> &changedColumns, vector<int> &coarseChanges)
+{
+    const int numRows = energyMatrix.height;
+
+    coarseMatrix.reshape((energyMatrix.width + 1) / 2, (numRows + 1) / 2);
+    coarseChanges.resize(coarseMatrix.height);
+
+    for (auto i = 0; i < coarseMatrix.height; ++i)
+    {
+        const int bottom = std::min(2 * i + 1, numRows - 1);
+
+        coarseChanges[i] = std::min(changedColumns[2 * i], changedColumns[bottom]) / 2;
+        energyKernels::poolRow(energyMatrix.row(2 * i), energyMatrix.row(bottom), coarseMatrix.row(i), coarseChanges[i],
+                               energyMatrix.width);
+    }
+}
+
+// Runs the vertical DP over a band of bandWidth columns either side of coarseSeam scaled up to this level,
+// then traces the seam inside it. Entries just outside the band are set to maxEnergy so neither the DP
+// nor the trace ever steps out of it
+void ImageCarverBase::bandedVertSeam(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                                     const vector<int> &coarseSeam, vector<int> &seam)
+{
+    const int numCols = energyMatrix.width;
+    const int numRows = energyMatrix.height;
+
+    cEnergyMatrix.reshape(numCols, numRows);
+    bandStarts.resize(numRows);
+    bandEnds.resize(numRows);
+
+    // A coarse pixel covers two columns, which the band extends on both sides
+    for (auto i = 0; i < numRows; ++i)
+    {
+        const int centre = std::min(2 * coarseSeam[i / 2], numCols - 1);
+        bandStarts[i] = std::max(centre - bandWidth, 0);
+        bandEnds[i] = std::min(centre + 2 + bandWidth, numCols);
+    }
+
+    for (auto i = 0; i < numRows; ++i)
+    {
+        const int start = bandStarts[i];
+        const int end = bandEnds[i];
+        Energy *cRow = cEnergyMatrix.row(i);
+
+        if (i == 0)
+            std::copy(energyMatrix.row(0) + start, energyMatrix.row(0) + end, cRow + start);
+        else
+            energyKernels::cumulativeRow(energyMatrix.row(i), cEnergyMatrix.row(i - 1), cRow, start, end, numCols);
+
+        // Wall off every entry the next row's band can reach as a parent
+        if (i < numRows - 1)
+        {
+            std::fill(cRow + std::max(std::min(start, bandStarts[i + 1] - 1), 0), cRow + start, energyKernels::maxEnergy);
+            std::fill(cRow + end, cRow + std::min(std::max(end, bandEnds[i + 1] + 1), numCols), energyKernels::maxEnergy);
+        }
+    }
+
+    this->traceVerticalSeam(cEnergyMatrix, seam, bandStarts[numRows - 1], bandEnds[numRows - 1]);
+}
+
+// Traces the lowest energy seam ending in columns [colStart, colEnd) of the bottom row back to the top
+void ImageCarverBase::traceVerticalSeam(const Image<Energy> &cEnergyMatrix, vector<int> &seam, const int &colStart,
+                                        const int &colEnd)
+{
+    const int numCols = cEnergyMatrix.width;
+    const int numRows = cEnergyMatrix.height;
+
+    // Start with bottom left pixel as lowest energy seam
+    const Energy *bottomRow = cEnergyMatrix.row(numRows - 1);
+    Energy lowestEnergySeam = bottomRow[colStart];
+    int index = colStart;
+
+    seam.resize(numRows);
+
+    // Find leftmost lowest energy seam in bottom row
+    for (auto j = colStart; j < colEnd; ++j)
+    {
+        if (bottomRow[j] < lowestEnergySeam)
+        {
+            lowestEnergySeam = bottomRow[j];
+            index = j;
+        }
+    }
+
+    // Loop through rows
+    for (auto i = (numRows - 1); i >= 0; --i)
+    {
+        seam[i] = index;
+
+        // If more rows above most recent pixel removed, move up to next leftmost pixel in seam
+        if (i > 0)
+        {
+            const Energy *prevRow = cEnergyMatrix.row(i - 1);
+            lowestEnergySeam = this->lowestParentEnergy(prevRow, index, numCols);
+
+            if (index > 0 && lowestEnergySeam == prevRow[index - 1])
+                index--;
+            else if (lowestEnergySeam == prevRow[index])
+                continue;
+            else
+                index++;
+        }
+    }
+}
+
+// Traces the lowest energy seam ending in the rightmost column back to the left edge
+void ImageCarverBase::traceHorizontalSeam(const Image<Energy> &cEnergyMatrix, vector<int> &seam)
+{
+    const int numCols = cEnergyMatrix.width;
+    const int numRows = cEnergyMatrix.height;
+    const int stride = cEnergyMatrix.stride;
+
+    // Start with top right pixel as lowest energy seam
+    const Energy *lastColumn = cEnergyMatrix.row(0) + (numCols - 1);
+    Energy lowestEnergySeam = lastColumn[0];
+    int index = 0;
+
+    seam.resize(numCols);
+
+    // Find topmost lowest energy seam in rightmost column
+    for (auto i = 0; i < numRows; ++i)
+    {
+        if (lastColumn[i * stride] < lowestEnergySeam)
+        {
+            lowestEnergySeam = lastColumn[i * stride];
+            index = i;
+        }
+    }
+
+    // Loop through columns, tracing the seam back to the left edge
+    for (auto j = (numCols - 1); j >= 0; --j)
+    {
+        seam[j] = index;
+
+        // If more columns left of most recent pixel, move to next topmost pixel in seam
+        if (j > 0)
+        {
+            const Energy *prevColumn = cEnergyMatrix.row(0) + (j - 1);
+            lowestEnergySeam = this->lowestParentEnergy(prevColumn, index, numRows, stride);
+
+            if (index > 0 && lowestEnergySeam == prevColumn[(index - 1) * stride])
+                index--;
+            else if (lowestEnergySeam == prevColumn[index * stride])
+                continue;
+            else
+                index++;
+        }
+    }
+}
+
+// Adds up the energy of the pixels on a seam, seam[j] being the row of column j for horizontal seams
+std::uint64_t ImageCarverBase::seamEnergy(const Image<Energy> &energyMatrix, const vector<int> &seam,
+                                          const bool &vertical)
+{
+    std::uint64_t energy = 0;
+
+    for (std::size_t n = 0; n < seam.size(); ++n)
+        energy += vertical ? energyMatrix.at(n, seam[n]) : energyMatrix.at(seam[n], n);
+
+    return energy;
+}
+
+// Traces a batch of seams that share no pixels through one cumulative energy matrix
+int ImageCarverBase::traceSeamBatch(const Image<Energy> &energyMatrix, const Image<Energy> &cEnergyMatrix,
+                                    const bool &vertical, const int &maxSeams)
+{
+    // Lines are rows for vertical seams and columns for horizontal ones
+    const int numLines = vertical ? cEnergyMatrix.height : cEnergyMatrix.width;
+    const int lineLength = vertical ? cEnergyMatrix.width : cEnergyMatrix.height;
+    const int lastLine = numLines - 1;
+    const int numSeams = std::min(maxSeams, lineLength);
+
+    auto cumulative = [&](const int &line, const int &index) {
+        return vertical ? cEnergyMatrix.at(line, index) : cEnergyMatrix.at(index, line);
+    };
+    auto taken = [&](const int &line, const int &index) -> uint8_t & {
+        return vertical ? seamMask.at(line, index) : seamMask.at(index, line);
+    };
+
+    seamMask.reshape(cEnergyMatrix.width, cEnergyMatrix.height);
+
+    for (auto i = 0; i < seamMask.height; ++i)
+        std::fill(seamMask.row(i), seamMask.row(i) + seamMask.width, 0);
+
+    // Seams start from the lowest cumulative energies in the last line, the lower index first on ties
+    seamStarts.resize(lineLength);
+    std::iota(seamStarts.begin(), seamStarts.end(), 0);
+    std::partial_sort(seamStarts.begin(), seamStarts.begin() + numSeams, seamStarts.end(),
+                      [&](const int &a, const int &b) {
+                          const Energy energyA = cumulative(lastLine, a);
+                          const Energy energyB = cumulative(lastLine, b);
+                          return energyA < energyB || (energyA == energyB && a < b);
+                      });
+
+    for (auto n = 0; n < numSeams; ++n)
+    {
+        int index = seamStarts[n];
+
+        for (auto line = lastLine; line >= 0; --line)
+        {
+            taken(line, index) = 1;
+            totalRemovedEnergy += vertical ? energyMatrix.at(line, index) : energyMatrix.at(index, line);
+
+            if (line == 0)
+                break;
+
+            // Lowest parent not claimed by an earlier seam, ties going to the lower index like the exact trace
+            int best = -1;
+
+            for (auto parent = std::max(index - 1, 0); parent <= std::min(index + 1, lineLength - 1); ++parent)
+            {
+                if (!taken(line - 1, parent) && (best < 0 || cumulative(line - 1, parent) < cumulative(line - 1, best)))
+                    best = parent;
+            }
+
+            // A seam hemmed in by earlier ones steps to the nearest free pixel instead, and the line
+            // above always has one while seams are left to trace
+            for (auto distance = 2; best < 0; ++distance)
+            {
+                for (const int parent : {index - distance, index + distance})
+                {
+                    if (parent >= 0 && parent < lineLength && !taken(line - 1, parent) &&
+                        (best < 0 || cumulative(line - 1, parent) < cumulative(line - 1, best)))
+                        best = parent;
+                }
+            }
+
+            index = best;
+        }
+    }
+
+    return numSeams;
+}
+
+// Finds the lowest cumulative energy among the parents of column j when columns are read through a map
+inline Energy ImageCarverBase::lowestMappedParentEnergy(const Energy *prevLine, const int *prevMap, const int &j,
+                                                        const int &numCols)
+{
+    Energy lowest = prevLine[prevMap[j]];
+
+    if (j > 0)
+        lowest = min(lowest, prevLine[prevMap[j - 1]]);
+    if (j < numCols - 1)
+        lowest = min(lowest, prevLine[prevMap[j + 1]]);
+
+    return lowest;
+}
+
+// Traces the lowest energy vertical seam through the column map
+void ImageCarverBase::findMappedVerticalSeam(const Image<Energy> &cEnergyMatrix, vector<int> &seam)
+{
+    const int numCols = columnMap.width;
+    const int numRows = columnMap.height;
+
+    // Find leftmost lowest energy seam in bottom row
+    const int *bottomMap = columnMap.row(numRows - 1);
+    const Energy *bottomRow = cEnergyMatrix.row(numRows - 1);
+    Energy lowestEnergySeam = bottomRow[bottomMap[0]];
+    int index = 0;
+
+    seam.resize(numRows);
+
+    for (auto j = 0; j < numCols; ++j)
+    {
+        if (bottomRow[bottomMap[j]] < lowestEnergySeam)
+        {
+            lowestEnergySeam = bottomRow[bottomMap[j]];
+            index = j;
+        }
+    }
+
+    // Move up row by row, preferring the leftmost of equally low parents
+    for (auto i = (numRows - 1); i >= 0; --i)
+    {
+        seam[i] = index;
+
+        if (i > 0)
+        {
+            const int *prevMap = columnMap.row(i - 1);
+            const Energy *prevRow = cEnergyMatrix.row(i - 1);
+            lowestEnergySeam = this->lowestMappedParentEnergy(prevRow, prevMap, index, numCols);
+
+            if (index > 0 && lowestEnergySeam == prevRow[prevMap[index - 1]])
+                index--;
+            else if (lowestEnergySeam == prevRow[prevMap[index]])
+                continue;
+            else
+                index++;
+        }
+    }
+}
+
+// Recomputes the cumulative energy cone below a seam that was dropped from the column map
+void ImageCarverBase::updateMappedVertCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                                                       const vector<int> &seam)
+{
+    const int numCols = columnMap.width;
+    const int numRows = columnMap.height;
+
+    // Same cone as updateVertCumulativeEnergy. Every remaining value is still stored with its own
+    // pixel, so nothing has to be shifted before comparing against it
+    int changedFirst = numCols;
+    int changedLast = -1;
+
+    for (auto i = 0; i < numRows; ++i)
+    {
+        const int *map = columnMap.row(i);
+        const Energy *energyRow = energyMatrix.row(i);
+        Energy *cRow = cEnergyMatrix.row(i);
+
+        int first = std::max(seam[i] - 2, 0);
+        int last = std::min(seam[i] + 1, numCols - 1);
+
+        if (changedFirst <= changedLast)
+        {
+            first = std::min(first, std::max(changedFirst - 1, 0));
+            last = std::max(last, std::min(changedLast + 1, numCols - 1));
+        }
+
+        changedFirst = numCols;
+        changedLast = -1;
+
+        // Same look-ahead as updateMappedVertEnergyMatrix
+        if (i + 8 < numRows)
+            prefetch(columnMap.row(i + 8) + seam[i + 8]);
+        if (i + 4 < numRows)
+        {
+            const int column = columnMap.row(i + 4)[seam[i + 4]];
+            prefetch(cEnergyMatrix.row(i + 4) + column);
+            prefetch(energyMatrix.row(i + 4) + column);
+        }
+
+        const int *prevMap = columnMap.row(i == 0 ? i : i - 1);
+        const Energy *prevRow = cEnergyMatrix.row(i == 0 ? i : i - 1);
+
+        for (auto j = first; j <= last; ++j)
+        {
+            Energy value = energyRow[map[j]];
+
+            if (i > 0)
+                value = saturatingAdd(value, this->lowestMappedParentEnergy(prevRow, prevMap, j, numCols));
+
+            if (value != cRow[map[j]])
+            {
+                cRow[map[j]] = value;
+                changedFirst = std::min(changedFirst, j);
+                changedLast = j;
+            }
+        }
+    }
+}
+
+// Runs the cumulative energy DP with two rolling lines, recording only the direction of every entry's
+// lowest parent in directionMap, and returns the index of the lowest entry in the last line
+int ImageCarverBase::compactCumulativeEnergy(const Image<Energy> &energyMatrix, const bool &vertical)
+{
+    // Lines are rows for vertical seams and columns for horizontal ones
+    const int numLines = vertical ? energyMatrix.height : energyMatrix.width;
+    const int lineLength = vertical ? energyMatrix.width : energyMatrix.height;
+
+    directionMap.reshape((lineLength + 3) / 4, numLines);
+    prevCumulativeLine.resize(lineLength);
+    cumulativeLine.resize(lineLength);
+
+    // Columns are gathered into a contiguous line so both directions share the row kernels
+    auto energyLine = [&](const int &line) -> const Energy * {
+        if (vertical)
+            return energyMatrix.row(line);
+
+        energyColumn.resize(lineLength);
+        for (auto i = 0; i < lineLength; ++i)
+            energyColumn[i] = energyMatrix.at(i, line);
+
+        return energyColumn.data();
+    };
+
+    const Energy *firstLine = energyLine(0);
+    std::copy(firstLine, firstLine + lineLength, prevCumulativeLine.begin());
+
+    for (auto line = 1; line < numLines; ++line)
+    {
+        energyKernels::parentDirections(prevCumulativeLine.data(), directionMap.row(line), lineLength);
+        energyKernels::cumulativeRow(energyLine(line), prevCumulativeLine.data(), cumulativeLine.data(), 0, lineLength,
+                                     lineLength);
+        prevCumulativeLine.swap(cumulativeLine);
+    }
+
+    // Leftmost (or topmost) lowest entry, like the trace over the full matrix
+    return static_cast<int>(std::min_element(prevCumulativeLine.begin(), prevCumulativeLine.end()) -
+                            prevCumulativeLine.begin());
+}
+
+// Memory the checkpointed DP holds for a numCols x numRows image: the checkpoint rows, the direction map
+// of one segment between them, the energy and rolling rows and the seam, all as removeVerticalSeamsCheckpointed
+// reserves them up front
+std::uint64_t ImageCarverBase::checkpointedBytes(const int &numCols, const int &numRows)
+{
+    const std::uint64_t interval = this->checkpointInterval(numCols, numRows);
+    const std::uint64_t numCheckpoints = (numRows - 1) / std::max<std::uint64_t>(interval - 1, 1) + 2;
+    const std::uint64_t directionBytes = (numCols + 3) / 4;
+
+    return numCheckpoints * numCols * sizeof(Energy) + (interval + 2) * directionBytes +
+           3 * static_cast<std::uint64_t>(numCols) * sizeof(Energy) + numRows * sizeof(int);
+}
+
+// Rows between checkpoints. Every row is recomputed once while backtracking whatever the interval, so
+// it is the one that takes the least memory: with 2-bit directions held for a segment and 32-bit
+// checkpoint rows, that is about 4 sqrt(numRows)
+int ImageCarverBase::checkpointInterval(const int &numCols, const int &numRows)
+{
+    const double checkpointRowBytes = static_cast<double>(numCols) * sizeof(Energy);
+    const double directionRowBytes = (numCols + 3) / 4;
+    const int interval = static_cast<int>(std::sqrt(numRows * checkpointRowBytes / directionRowBytes));
+
+    return std::max(1, std::min(interval, numRows));
+}
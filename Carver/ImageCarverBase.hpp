@@ -0,0 +1,336 @@
+/*
+    ImageCarverBase.hpp
+
+    Include file for the settings, cumulative energy DPs and seam traces the carver shares between
+    every pixel type and channel count.
+*/
+
+#include "EnergyKernels.hpp"
+#include "Image.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef INCLUDED_IMAGECARVERBASE_HPP
+#define INCLUDED_IMAGECARVERBASE_HPP
+
+class ImageCarverBase
+{
+public:
+    // How the parallel cumulative energy DP is divided between threads
+    enum class Schedule
+    {
+        Rows,  // Every thread takes a slice of each row, with a barrier after every row
+        Tiles  // Trapezoid tiles spanning several rows, with two barriers per band of rows
+    };
+
+    struct pgmData
+    {
+        std::string version;
+        std::string comment;
+        int columns;
+        int rows;
+        int maxValue;
+        int channels;
+        bool binary;
+        std::size_t rasterOffset;
+    };
+
+protected:
+    pgmData data;
+
+    // Shortest DP row (or column, for horizontal seams) that is split across threads. Tiles
+    // synchronise far less often, so they pay off on much narrower images
+    static constexpr int minParallelLength = 1024;
+    static constexpr int minTiledLength = 256;
+
+    // Tallest band of rows covered by one set of tiles
+    static constexpr int maxBandHeight = 64;
+
+    // Fewest pixels whose energies are computed across threads
+    static constexpr int minParallelEnergy = 1 << 18;
+
+    int numThreads;
+
+    Schedule schedule;
+
+    // Vertical seams removed between compactions when removal is deferred, 0 compacting only after
+    // the last one. Negative values shift every seam out of the buffers straight away
+    int compactInterval;
+
+    // Buffer column of every remaining pixel, row by row, while vertical seam removal is deferred
+    Image<int> columnMap;
+
+    // Seams taken from each cumulative energy pass. Above 1, seams are traced greedily around each
+    // other and removed together, trading some seam quality for far fewer DP passes
+    int batchSize;
+
+    // Pixels claimed by the seams of the current batch, and the bottom line entries they start from
+    Image<uint8_t> seamMask;
+    std::vector<int> seamStarts;
+
+    // Keeps no cumulative energy matrix: every seam reruns the DP with two rolling lines and is traced
+    // back through a map of 2-bit parent directions, a sixteenth of the matrix's size
+    bool compactDp;
+
+    // Packed parent directions, one line per row (or column, for horizontal seams), and the rolling lines
+    Image<uint8_t> directionMap;
+    std::vector<Energy> prevCumulativeLine;
+    std::vector<Energy> cumulativeLine;
+    std::vector<Energy> energyColumn;
+
+    // Memory the out-of-core mode may hold on to, 0 to keep the whole image and its matrices in memory
+    std::uint64_t memoryBudget;
+
+    // Cumulative energy rows kept by the checkpointed DP, and the energy row being worked on
+    Image<Energy> checkpoints;
+    std::vector<Energy> energyLine;
+
+    // Halvings of the energy matrix searched for each vertical seam before refining it at full size, 0 to
+    // search at full size only, and the columns either side of the coarser seam each refinement looks at
+    int pyramidLevels;
+    int bandWidth;
+
+    // Levels stop before either side drops below this
+    static constexpr int minPyramidSize = 16;
+
+    // Energy and cumulative energy of every coarser level and the first column of each of its rows
+    // that changed on the last rebuild, the seam found on the level below and the band of columns
+    // searched in each row
+    std::vector<Image<Energy>> pyramidEnergy;
+    std::vector<Image<Energy>> pyramidCumulative;
+    std::vector<std::vector<int>> pyramidChanges;
+    std::vector<int> coarseSeam;
+    std::vector<int> bandStarts;
+    std::vector<int> bandEnds;
+
+    // Number of the vertical seam that removes each pixel of the original image, in removal order
+    Image<int> seamIndexMap;
+
+    // Directory seam index maps are cached in between runs, none if empty, and its size limit in bytes
+    std::string cacheDirectory;
+    std::uint64_t cacheLimit;
+
+    static constexpr std::uint64_t defaultCacheLimit = 256ull << 20;
+
+    // Energy of every pixel removed since the start of the current carve
+    std::uint64_t totalRemovedEnergy;
+
+    // Energy matrices, seam and per-row scratch of the carve in progress. Kept between carves and, like
+    // every buffer above, only ever grown, so reserveArena sizes them all before the first seam
+    Image<Energy> pixelEnergy;
+    Image<Energy> cumulativeEnergy;
+    std::vector<int> currentSeam;
+    std::vector<int> changedColumns;
+    Image<int> originalColumns;
+    std::vector<int> removedAbove;
+
+    // Heap allocations made while removing seams during the last carve, counted only when the library
+    // is built with CARVE_COUNT_ALLOCATIONS
+    std::uint64_t loopAllocations;
+
+    // Sizes every buffer the seam loops of the current settings use for a numCols x numRows image and
+    // starts the thread pool, so removing seams from an image no larger than that never allocates
+    void reserveArena(const int &numCols, const int &numRows);
+
+    // Created on first use and kept for every later DP pass, unless the caller lends a pool of its own
+    std::unique_ptr<ThreadPool> pool;
+    ThreadPool *lentPool;
+
+    // Leaves out the line reporting each image written
+    bool quiet;
+
+    ThreadPool &threadPool();
+
+    // How many of batches, compact DP, pyramid search and deferred removal are on. Each replaces the
+    // others' way of finding and removing seams rather than adding to it
+    int numModes() const;
+
+    // Hints that the cache line holding address is about to be read
+    static void prefetch(const void *address)
+    {
+#ifdef __GNUC__
+        __builtin_prefetch(address);
+#endif
+    }
+
+    // Locale-free test for the whitespace characters allowed between PNM tokens
+    static bool isSeparator(const char &c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    // Moves pos past whitespace and '#' comments, returning the start of the first comment skipped
+    static const char *skipSeparators(const char *&pos, const char *end);
+
+    // Splits a comma-separated list of seam counts such as "100,250,400", negative counts removing nothing.
+    // Returns no counts at all if an entry is empty or not a whole number
+    static std::vector<int> parseSeamCounts(const char *list);
+
+    // Whether every count of a list of vertical seams, each followed by horizontalSeams, leaves at least
+    // one pixel of a numCols x numRows image. Prints the same error as a single carve if not
+    static bool seamCountsFit(const char *verticalSeams, const char *horizontalSeams, const int &numCols,
+                              const int &numRows);
+
+    // Follows the lowest parents up from the lowest entry in columns [colStart, colEnd) of the bottom row,
+    // leftmost first, recording the column of each row in seam
+    void traceVerticalSeam(const Image<Energy> &cEnergyMatrix, std::vector<int> &seam, const int &colStart,
+                           const int &colEnd);
+
+    // Same from the topmost lowest entry of the rightmost column, recording the row of each column in seam
+    void traceHorizontalSeam(const Image<Energy> &cEnergyMatrix, std::vector<int> &seam);
+
+    // Approximates the lowest energy vertical seam with an energy pyramid, using cEnergyMatrix only
+    // inside the band around the seam. The coarser levels are kept between calls and only rebuilt
+    // from changedColumns[i] on in each row i of energyMatrix, all zeros on the first call
+    void findVerticalSeamPyramid(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix, std::vector<int> &seam,
+                                 const std::vector<int> &changedColumns);
+
+    void downsampleEnergy(const Image<Energy> &energyMatrix, Image<Energy> &coarseMatrix,
+                          const std::vector<int> &changedColumns, std::vector<int> &coarseChanges);
+
+    void bandedVertSeam(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                        const std::vector<int> &coarseSeam, std::vector<int> &seam);
+
+    // Parents are read from prevLine at indices j - 1, j and j + 1, step elements apart
+    Energy lowestParentEnergy(const Energy *prevLine, const int &j, const int &numCols, const int &step = 1);
+
+    // Same, with the parents of column j found at prevLine[prevMap[j - 1]] and so on
+    Energy lowestMappedParentEnergy(const Energy *prevLine, const int *prevMap, const int &j, const int &numCols);
+
+    // Traces the lowest energy vertical seam through columnMap, recording map columns in seam
+    void findMappedVerticalSeam(const Image<Energy> &cEnergyMatrix, std::vector<int> &seam);
+
+    void updateMappedVertCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix,
+                                          const std::vector<int> &seam);
+
+    // Traces up to maxSeams seams without shared pixels from one cumulative energy pass into seamMask,
+    // starting from the lowest entries of the last row (or column) and stepping to the lowest parent
+    // no earlier seam has taken. Returns the number of seams traced, maxSeams unless the line is shorter
+    int traceSeamBatch(const Image<Energy> &energyMatrix, const Image<Energy> &cEnergyMatrix, const bool &vertical,
+                       const int &maxSeams);
+
+    // Energy of the pixels on a seam that is about to be removed
+    std::uint64_t seamEnergy(const Image<Energy> &energyMatrix, const std::vector<int> &seam, const bool &vertical);
+
+    // Compact DP over rows (vertical) or columns, returning where the lowest energy seam ends
+    int compactCumulativeEnergy(const Image<Energy> &energyMatrix, const bool &vertical);
+
+    std::uint64_t checkpointedBytes(const int &numCols, const int &numRows);
+
+    int checkpointInterval(const int &numCols, const int &numRows);
+
+    // DP over columns [colStart, colEnd) only, waiting on barrier after every row when one is given
+    void vertCumulativeColumns(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix, const int &colStart,
+                               const int &colEnd, SpinBarrier *barrier);
+
+    void horizCumulativeRows(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix, const int &rowStart,
+                             const int &rowEnd, SpinBarrier *barrier);
+
+    // Calls span(line, first, last) to fill indices [first, last) of a line, covering every cell of a
+    // numLines x lineLength DP whose lines depend on indices -1, 0 and +1 of the line before, using
+    // trapezoid and triangle tiles on the thread pool
+    template <typename Span>
+    void tiledCumulativeEnergy(const int &numLines, const int &lineLength, Span span);
+
+    // Shift the cumulative matrix over a removed seam and recompute only the cone beyond it
+    void updateVertCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix, const std::vector<int> &seam);
+
+    void updateHorizCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix, const std::vector<int> &seam);
+
+public:
+    ImageCarverBase();
+
+    // Reads the settings following the image and seam counts, returns false after printing the
+    // problem if there are too few arguments, an option is unknown or the settings conflict
+    bool parseOptions(int argc, char *argv[]);
+
+    // Why the current settings cannot be honoured together, or null if they can. Every carve refuses
+    // them, whether its settings came from parseOptions or from the setters
+    const char *conflictingSettings() const;
+
+    // Name of the output of inputName, next to it and with the extension matching its channel count
+    std::string outputFileName(const std::string &inputName, const std::string &verticalSeams,
+                               const std::string &horizontalSeams, const int &channels);
+
+    // Threads used by the cumulative energy DP, the output does not depend on it
+    void setThreads(const int &threads);
+
+    void setSchedule(const Schedule &dpSchedule);
+
+    // Leaves removed pixels in place and compacts the image every interval vertical seams, or only
+    // once at the end for 0. A negative interval shifts every seam out as soon as it is found
+    void setDeferredRemoval(const int &interval);
+
+    // Number of seams removed per cumulative energy pass. 1, the default, removes the exact lowest
+    // energy seam every time; larger batches are approximate and cannot be combined with the other modes
+    void setBatchSize(const int &seams);
+
+    // Trades the incremental cumulative energy updates for a full compact DP per seam, cutting the memory
+    // the DP holds on to by 16x with the same seams. Cannot be combined with batches, pyramids or deferred removal
+    void setCompactDp(const bool &enabled);
+
+    // Searches each vertical seam on an energy pyramid levels halvings down, then refines it level by level
+    // within band columns either side of the coarser seam. Wider bands stay closer to the exact seam
+    void setPyramidSearch(const int &levels, const int &band = 4);
+
+    // Carves images too large for memory: pixels are paged from scratch files next to the output and the
+    // DP keeps only checkpoint rows, recomputing the rows between them while backtracking. maxBytes bounds
+    // the DP's own buffers; the mapped pixels are left to the OS to page and are not counted. 0 turns it off
+    void setMemoryBudget(const std::uint64_t &maxBytes);
+
+    // Keeps seam index maps in directory between runs, deleting the least recently used ones once
+    // they take more than maxBytes. An empty directory turns the cache off
+    void setSeamMapCache(const std::string &directory, const std::uint64_t &maxBytes = defaultCacheLimit);
+
+    // Runs the parallel stages on workers, which the caller keeps alive while it is in use, instead of a
+    // pool of the carver's own. nullptr goes back to setThreads. Seams do not depend on the pool either
+    void useThreadPool(ThreadPool *workers);
+
+    void setQuiet(const bool &enabled);
+
+    // Sum of the energies of every pixel the last carve removed, as they stood when its seam was chosen.
+    // Lower is better, which makes it a measure of how far approximate modes drift from exact removal
+    std::uint64_t removedEnergy() const;
+
+    // Heap allocations made between the first and last seam of the last carve, which should be 0. Always
+    // 0 unless the library is built with CARVE_COUNT_ALLOCATIONS
+    std::uint64_t seamLoopAllocations() const;
+
+    // Splits the rows across the thread pool for wide images, otherwise runs serially
+    void vertCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix);
+
+    // Column by column counterpart of vertCumulativeEnergy, working on the same row-major matrices
+    void horizCumulativeEnergy(const Image<Energy> &energyMatrix, Image<Energy> &cEnergyMatrix);
+
+    // Detects P2/P3/P5/P6 from the magic number and validates the header, returns false if unsupported
+    static bool readHeader(const MappedFile &file, pgmData &imageData);
+
+    // Usage: <image> <vertical seams>[,<vertical seams>...] <horizontal seams> [--threads=N]
+    //        [--schedule=rows|tiles] [--deferred[=N]] [--batch=K] [--compact-dp] [--cache=DIR] [--cache-size=MB]
+    //        [--memory-budget=MB] [--pyramid=L] [--band=B]
+    // Several vertical seam counts write one image each, all gathered from a single seam index map
+    static void printUsage(const char *program);
+};
+
+// Finds the lowest cumulative energy of the up to three pixels leading into index j
+inline Energy ImageCarverBase::lowestParentEnergy(const Energy *prevLine, const int &j, const int &numCols,
+                                                  const int &step)
+{
+    Energy lowest = prevLine[j * step];
+
+    // Pixels on the edges only have two parents
+    if (j > 0)
+        lowest = std::min(lowest, prevLine[(j - 1) * step]);
+    if (j < numCols - 1)
+        lowest = std::min(lowest, prevLine[(j + 1) * step]);
+
+    return lowest;
+}
+
+#endif
@@ -0,0 +1,172 @@
+/*
+    MappedFile.hpp
+
+    Read-only memory mapping of an input image file, and writable mappings of scratch files.
+*/
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#include <vector>
+#else
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#endif
+
+#ifndef INCLUDED_MAPPEDFILE_HPP
+#define INCLUDED_MAPPEDFILE_HPP
+
+// Maps a whole file into memory so rasters can be copied straight into image buffers.
+// data() is null if the file could not be opened or is empty.
+class MappedFile
+{
+private:
+    const char *mappedData = nullptr;
+    std::size_t mappedSize = 0;
+
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+
+public:
+    explicit MappedFile(const std::string &fileName)
+    {
+#ifdef _WIN32
+        // No mmap here, fall back to a single bulk read
+        std::ifstream file(fileName, std::ios::binary);
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        if (!buffer.empty())
+        {
+            mappedData = buffer.data();
+            mappedSize = buffer.size();
+        }
+#else
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (address != MAP_FAILED)
+            {
+                madvise(address, info.st_size, MADV_SEQUENTIAL);
+                mappedData = static_cast<const char *>(address);
+                mappedSize = info.st_size;
+            }
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (mappedData)
+            munmap(const_cast<char *>(mappedData), mappedSize);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return mappedData; }
+
+    std::size_t size() const { return mappedSize; }
+};
+
+// Maps a new file of the given size for reading and writing, so large buffers are paged to disk by the
+// OS instead of held in memory. The file gets a unique name in the directory asked for, or in $TMPDIR
+// (/tmp by default) if it cannot be created there, so neither a file left by a crashed run nor another
+// carve can get in the way. It is removed straight away and only lives as long as the mapping. data() is
+// null if the file could not be created anywhere
+class MappedScratchFile
+{
+private:
+    char *mappedData = nullptr;
+    std::size_t mappedSize = 0;
+
+#ifdef _WIN32
+    std::vector<char> buffer;
+#else
+    // Creates, unlinks and maps a file of size bytes in directory, returning whether it did
+    bool map(const std::string &directory, const std::size_t &size)
+    {
+        std::string pattern = (directory.empty() ? std::string(".") : directory) + "/.carve_scratch_XXXXXX";
+        std::vector<char> fileName(pattern.begin(), pattern.end());
+        fileName.push_back('\0');
+
+        int fd = mkstemp(fileName.data());
+        if (fd < 0)
+            return false;
+
+        // Unlinking now means the file cannot be left behind, the mapping keeps its blocks alive
+        unlink(fileName.data());
+
+        if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+        {
+            void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (address != MAP_FAILED)
+            {
+                mappedData = static_cast<char *>(address);
+                mappedSize = size;
+            }
+        }
+
+        close(fd);
+        return mappedData != nullptr;
+    }
+#endif
+
+public:
+    MappedScratchFile(const std::string &directory, const std::size_t &size)
+    {
+        if (size == 0)
+            return;
+
+#ifdef _WIN32
+        // No mmap here, the buffer is held in memory instead
+        buffer.resize(size);
+        mappedData = buffer.data();
+        mappedSize = size;
+#else
+        if (!this->map(directory, size))
+        {
+            const char *temporaryDirectory = std::getenv("TMPDIR");
+            this->map(temporaryDirectory && *temporaryDirectory ? temporaryDirectory : "/tmp", size);
+        }
+#endif
+    }
+
+    ~MappedScratchFile()
+    {
+#ifndef _WIN32
+        if (mappedData)
+            munmap(mappedData, mappedSize);
+#endif
+    }
+
+    MappedScratchFile(const MappedScratchFile &) = delete;
+
+    MappedScratchFile &operator=(const MappedScratchFile &) = delete;
+
+    char *data() { return mappedData; }
+
+    std::size_t size() const { return mappedSize; }
+};
+
+#endif
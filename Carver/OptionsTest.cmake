@@ -0,0 +1,67 @@
+# Carves IMAGE by VERTICAL and HORIZONTAL seams with CARVER once per option. Options that only change how
+# the seams are found must give the same image as no option at all, approximate modes must still carve,
+# and unknown options must be refused. Every front end runs it, so they all accept the same options.
+# Usage: cmake -DCARVER=<carve_seam> -DIMAGE=<image> -DVERTICAL=<seams> -DHORIZONTAL=<seams> -P OptionsTest.cmake
+
+set(exactOptions --threads=1 --threads=4 --schedule=rows --schedule=tiles --deferred --deferred=3 --compact-dp
+    --memory-budget=16 --cache=cache --band=2)
+set(approximateOptions --batch=4 --pyramid=2)
+
+# Carves a copy of the image in its own directory, so outputs and the cache never mix with other runs
+get_filename_component(imageName ${IMAGE} NAME)
+get_filename_component(baseName ${IMAGE} NAME_WE)
+get_filename_component(extension ${IMAGE} LAST_EXT)
+
+set(workDirectory ${CMAKE_CURRENT_BINARY_DIR}/options_test_${baseName})
+file(REMOVE_RECURSE ${workDirectory})
+file(MAKE_DIRECTORY ${workDirectory})
+file(COPY ${IMAGE} DESTINATION ${workDirectory})
+
+set(output ${workDirectory}/${baseName}_processed_${VERTICAL}_${HORIZONTAL}${extension})
+set(failures 0)
+
+# Carves with the options given after the result variable, leaving the exit status in it
+function(carve status)
+    file(REMOVE ${output})
+    execute_process(COMMAND ${CARVER} ${imageName} ${VERTICAL} ${HORIZONTAL} ${ARGN}
+                    WORKING_DIRECTORY ${workDirectory} RESULT_VARIABLE result OUTPUT_QUIET ERROR_QUIET)
+    set(${status} ${result} PARENT_SCOPE)
+endfunction()
+
+carve(status)
+if (NOT status EQUAL 0 OR NOT EXISTS ${output})
+    message(FATAL_ERROR "Carving ${imageName} without options failed")
+endif()
+file(RENAME ${output} ${workDirectory}/reference${extension})
+
+# Scratch files of the name an earlier out-of-core carve used, left by a crash, must not get in the way
+file(WRITE ${output}.pixels "")
+file(WRITE ${output}.transposed "")
+
+foreach (option ${exactOptions})
+    carve(status ${option})
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${output} ${workDirectory}/reference${extension}
+                    RESULT_VARIABLE differs OUTPUT_QUIET ERROR_QUIET)
+
+    if (NOT status EQUAL 0 OR NOT differs EQUAL 0)
+        message(SEND_ERROR "${option} does not give the image carved without options")
+        math(EXPR failures "${failures} + 1")
+    endif()
+endforeach()
+
+foreach (option ${approximateOptions})
+    carve(status ${option})
+
+    if (NOT status EQUAL 0 OR NOT EXISTS ${output})
+        message(SEND_ERROR "${option} did not carve ${imageName}")
+        math(EXPR failures "${failures} + 1")
+    endif()
+endforeach()
+
+carve(status --no-such-option)
+if (status EQUAL 0)
+    message(SEND_ERROR "An unknown option was accepted")
+    math(EXPR failures "${failures} + 1")
+endif()
+
+message(STATUS "${failures} options misbehaved")
@@ -0,0 +1,95 @@
+# Carves IMAGE, WIDTH x HEIGHT pixels, with CARVER and requests that cannot be honoured, each of which
+# must be refused without writing any image, and with a few at the limits that must be carved. Every
+# front end runs it, so they all refuse the same requests.
+# Usage: cmake -DCARVER=<carve_seam> -DIMAGE=<image> -DWIDTH=<columns> -DHEIGHT=<rows> -P SeamCountTest.cmake
+
+get_filename_component(imageName ${IMAGE} NAME)
+get_filename_component(baseName ${IMAGE} NAME_WE)
+
+set(workDirectory ${CMAKE_CURRENT_BINARY_DIR}/seam_count_test_${baseName})
+file(REMOVE_RECURSE ${workDirectory})
+file(MAKE_DIRECTORY ${workDirectory})
+file(COPY ${IMAGE} DESTINATION ${workDirectory})
+
+math(EXPR lastColumn "${WIDTH} - 1")
+math(EXPR lastRow "${HEIGHT} - 1")
+math(EXPR pastHeight "${HEIGHT} + 20")
+
+# Carves with the arguments after the image, leaving the exit status and whether any image was written
+function(carve status wrote)
+    file(GLOB outputs ${workDirectory}/*_processed_*)
+    if (outputs)
+        file(REMOVE ${outputs})
+    endif()
+
+    execute_process(COMMAND ${CARVER} ${imageName} ${ARGN}
+                    WORKING_DIRECTORY ${workDirectory} RESULT_VARIABLE result OUTPUT_QUIET ERROR_QUIET)
+    file(GLOB outputs ${workDirectory}/*_processed_*)
+
+    set(${status} ${result} PARENT_SCOPE)
+    if (outputs)
+        set(${wrote} TRUE PARENT_SCOPE)
+    else()
+        set(${wrote} FALSE PARENT_SCOPE)
+    endif()
+endfunction()
+
+function(expectRefused)
+    carve(status wrote ${ARGN})
+    string(REPLACE ";" " " request "${ARGN}")
+
+    if (status EQUAL 0 OR wrote)
+        message(SEND_ERROR "\"${request}\" was not refused")
+    endif()
+endfunction()
+
+function(expectCarved)
+    carve(status wrote ${ARGN})
+    string(REPLACE ";" " " request "${ARGN}")
+
+    if (NOT status EQUAL 0 OR NOT wrote)
+        message(SEND_ERROR "\"${request}\" was not carved")
+    endif()
+endfunction()
+
+# Lists of widths
+expectCarved(5,10 3)
+expectCarved(0,${lastColumn} ${lastRow})
+expectRefused(5,10 ${HEIGHT})
+expectRefused(5,10 ${pastHeight})
+expectRefused(${WIDTH},5 0)
+expectRefused(5,,6 0)
+expectRefused(5, 0)
+expectRefused(,5 0)
+expectRefused(5,x 0)
+
+# A single width through the seam map cache
+expectCarved(${lastColumn} ${lastRow} --cache=cache)
+expectRefused(5 ${HEIGHT} --cache=cache)
+expectRefused(${WIDTH} 0 --cache=cache)
+
+# Out of core, which must refuse the same counts rather than carving fewer seams
+expectCarved(${lastColumn} ${lastRow} --memory-budget=16)
+expectRefused(${WIDTH} 0 --memory-budget=16)
+expectRefused(5 ${HEIGHT} --memory-budget=16)
+expectRefused(5 3 --memory-budget=16 --batch=4)
+expectRefused(5 3 --memory-budget=16 --deferred)
+expectRefused(5 3 --memory-budget=16 --pyramid=2)
+expectRefused(5 3 --memory-budget=16 --compact-dp)
+
+# Modes that each replace the others' way of finding and removing seams
+expectRefused(5 3 --pyramid=2 --compact-dp)
+expectRefused(5 3 --batch=4 --deferred)
+expectRefused(5 3 --compact-dp --deferred=3)
+expectRefused(5 3 --batch=4 --pyramid=2)
+expectCarved(5 3 --batch=1 --pyramid=2)
+
+# Lists and the cache, whose exact seam index map none of the modes apply to
+expectRefused(5,10 3 --batch=4)
+expectRefused(5,10 3 --pyramid=2)
+expectRefused(5,10 3 --deferred)
+expectRefused(5,10 3 --compact-dp)
+expectRefused(5 3 --cache=cache --batch=4)
+expectRefused(5 3 --cache=cache --pyramid=2)
+expectRefused(5 3 --cache=cache --deferred=3)
+expectCarved(5,10 3 --batch=1)
@@ -0,0 +1,274 @@
+/*
+    SeamMapCache.cpp
+
+    Implementation file for the seam index map cache.
+*/
+
+#include "SeamMapCache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+using std::string;
+using std::vector;
+
+namespace
+{
+    const char entryMagic[8] = {'S', 'E', 'A', 'M', 'M', 'A', 'P', '\0'};
+    const char entryExtension[] = ".seammap";
+
+    // Entries written so far by this process, numbering their partial files
+    std::atomic<unsigned> partialCount{0};
+
+    // Name of a partial file no other writer uses, whether another thread of this process or another
+    // process storing the same key
+    string uniquePartialPath(const string &path)
+    {
+#ifdef _WIN32
+        const int processId = _getpid();
+#else
+        const int processId = static_cast<int>(getpid());
+#endif
+        return path + "." + std::to_string(processId) + "." + std::to_string(partialCount++) + ".partial";
+    }
+
+    // Writes one row of seam numbers at the entry's index width
+    template <typename IndexT>
+    bool writeIndexRow(std::ofstream &file, const int *row, const int &width, vector<IndexT> &buffer)
+    {
+        buffer.assign(row, row + width);
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(width * sizeof(IndexT)));
+
+        return static_cast<bool>(file);
+    }
+
+    // Whether every row of a map recording numSeams seams removes each of them exactly once and keeps
+    // the rest at numSeams, so that gathering any width up to it fills each row exactly
+    template <typename IndexT>
+    bool validIndices(const IndexT *indices, const int &width, const int &height, const std::uint32_t &numSeams)
+    {
+        // Row each seam was last seen on, catching a seam that removes two pixels of one row
+        vector<int> seenOnRow(numSeams, -1);
+
+        for (auto i = 0; i < height; ++i)
+        {
+            const IndexT *row = indices + static_cast<std::size_t>(i) * width;
+            std::uint32_t removed = 0;
+
+            for (auto j = 0; j < width; ++j)
+            {
+                const std::uint32_t seam = row[j];
+
+                if (seam > numSeams || (seam < numSeams && seenOnRow[seam] == i))
+                    return false;
+
+                if (seam < numSeams)
+                {
+                    seenOnRow[seam] = i;
+                    removed++;
+                }
+            }
+
+            if (removed != numSeams)
+                return false;
+        }
+
+        return true;
+    }
+}
+
+SeamMapCache::SeamMapCache(const string &cacheDirectory, const std::uint64_t &sizeLimit)
+{
+    directory = cacheDirectory;
+    maxBytes = sizeLimit;
+}
+
+// Hashes a buffer with 64-bit FNV-1a
+std::uint64_t SeamMapCache::hash(const void *bytes, const std::size_t &size, const std::uint64_t &seed)
+{
+    const unsigned char *byte = static_cast<const unsigned char *>(bytes);
+    std::uint64_t value = seed;
+
+    for (std::size_t n = 0; n < size; ++n)
+    {
+        value ^= byte[n];
+        value *= 1099511628211ull;
+    }
+
+    return value;
+}
+
+// Entries are named after their key in hex
+string SeamMapCache::entryPath(const std::uint64_t &key) const
+{
+    char name[17];
+    static const char digits[] = "0123456789abcdef";
+
+    for (auto n = 0; n < 16; ++n)
+        name[n] = digits[(key >> (60 - 4 * n)) & 15];
+    name[16] = '\0';
+
+    return (fs::path(directory) / (string(name) + entryExtension)).string();
+}
+
+// Looks up a cached seam index map, checking it was written for this image and is whole
+std::unique_ptr<MappedFile> SeamMapCache::find(const std::uint64_t &key, const int &width, const int &height,
+                                               const int &numSeams)
+{
+    const string path = this->entryPath(key);
+    auto entry = std::make_unique<MappedFile>(path);
+
+    if (!entry->data() || entry->size() < sizeof(SeamMapHeader))
+        return nullptr;
+
+    const SeamMapHeader &entryHeader = header(*entry);
+    const std::size_t indexBytes = entryHeader.indexBytes;
+
+    if (std::memcmp(entryHeader.magic, entryMagic, sizeof(entryMagic)) != 0 || entryHeader.version != formatVersion ||
+        entryHeader.key != key || entryHeader.width != static_cast<std::uint32_t>(width) ||
+        entryHeader.height != static_cast<std::uint32_t>(height) ||
+        entryHeader.numSeams < static_cast<std::uint32_t>(numSeams) ||
+        entryHeader.numSeams >= static_cast<std::uint32_t>(width) || (indexBytes != 2 && indexBytes != 4) ||
+        entry->size() != sizeof(SeamMapHeader) + indexBytes * width * height)
+        return nullptr;
+
+    // Damaged or edited seam numbers would gather more pixels into a row than it holds
+    bool valid;
+    if (indexBytes == 2)
+        valid = validIndices(static_cast<const std::uint16_t *>(indices(*entry)), width, height, entryHeader.numSeams);
+    else
+        valid = validIndices(static_cast<const std::uint32_t *>(indices(*entry)), width, height, entryHeader.numSeams);
+
+    if (!valid)
+        return nullptr;
+
+    // The modification time doubles as the last use, since access times are often not kept
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+
+    return entry;
+}
+
+const SeamMapHeader &SeamMapCache::header(const MappedFile &entry)
+{
+    return *reinterpret_cast<const SeamMapHeader *>(entry.data());
+}
+
+const void *SeamMapCache::indices(const MappedFile &entry)
+{
+    return entry.data() + sizeof(SeamMapHeader);
+}
+
+// Writes an entry to a partial file of its own next to the final name and renames it into place, so
+// readers never see half a file and concurrent writers of one key never mix their rows
+bool SeamMapCache::store(const std::uint64_t &key, const Image<int> &seamIndexMap, const int &numSeams)
+{
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    const string path = this->entryPath(key);
+    const string partialPath = uniquePartialPath(path);
+
+    SeamMapHeader entryHeader = {};
+    std::memcpy(entryHeader.magic, entryMagic, sizeof(entryMagic));
+    entryHeader.version = formatVersion;
+    entryHeader.width = seamIndexMap.width;
+    entryHeader.height = seamIndexMap.height;
+    entryHeader.numSeams = numSeams;
+    entryHeader.indexBytes = numSeams <= 0xffff ? 2 : 4;
+    entryHeader.key = key;
+
+    {
+        std::ofstream file(partialPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&entryHeader), sizeof(entryHeader));
+
+        vector<std::uint16_t> narrowRow;
+        vector<std::uint32_t> wideRow;
+        bool written = static_cast<bool>(file);
+
+        for (auto i = 0; i < seamIndexMap.height && written; ++i)
+        {
+            if (entryHeader.indexBytes == 2)
+                written = writeIndexRow(file, seamIndexMap.row(i), seamIndexMap.width, narrowRow);
+            else
+                written = writeIndexRow(file, seamIndexMap.row(i), seamIndexMap.width, wideRow);
+        }
+
+        // Data still buffered is only written on close, which can fail as well
+        file.close();
+
+        if (!written || !file)
+        {
+            fs::remove(partialPath, error);
+            return false;
+        }
+    }
+
+    fs::rename(partialPath, path, error);
+    if (error)
+    {
+        fs::remove(partialPath, error);
+        return false;
+    }
+
+    this->evict(path);
+
+    return true;
+}
+
+// Removes entries oldest first until the cache is back under its size limit
+void SeamMapCache::evict(const string &keep)
+{
+    struct Entry
+    {
+        fs::path path;
+        fs::file_time_type lastUse;
+        std::uint64_t size;
+    };
+
+    vector<Entry> entries;
+    std::uint64_t totalBytes = 0;
+    std::error_code error;
+
+    for (auto it = fs::directory_iterator(directory, error); !error && it != fs::directory_iterator(); it.increment(error))
+    {
+        std::error_code entryError;
+
+        if (it->path().extension() != entryExtension || !it->is_regular_file(entryError))
+            continue;
+
+        Entry entry = {it->path(), it->last_write_time(entryError), it->file_size(entryError)};
+        if (entryError)
+            continue;
+
+        entries.push_back(entry);
+        totalBytes += entry.size;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.lastUse < b.lastUse; });
+
+    for (auto &entry : entries)
+    {
+        if (totalBytes <= maxBytes)
+            break;
+
+        if (entry.path == fs::path(keep))
+            continue;
+
+        std::error_code entryError;
+        if (fs::remove(entry.path, entryError))
+            totalBytes -= entry.size;
+    }
+}
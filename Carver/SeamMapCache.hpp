@@ -0,0 +1,70 @@
+/*
+    SeamMapCache.hpp
+
+    Directory of seam index maps kept between runs, so repeated carves of the same image skip the
+    energy and cumulative energy passes.
+*/
+
+#include "Image.hpp"
+#include "MappedFile.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#ifndef INCLUDED_SEAMMAPCACHE_HPP
+#define INCLUDED_SEAMMAPCACHE_HPP
+
+// Every entry is a file named after its key, holding this header followed by width x height seam
+// numbers of indexBytes each, row by row. Files are written in native byte order and mapped as is
+struct SeamMapHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t numSeams;
+    std::uint32_t indexBytes;
+    std::uint32_t reserved;
+    std::uint64_t key;
+};
+
+class SeamMapCache
+{
+private:
+    std::string directory;
+
+    // Total size of the entries above which the least recently used ones are deleted
+    std::uint64_t maxBytes;
+
+    std::string entryPath(const std::uint64_t &key) const;
+
+    // Deletes the least recently used entries until the directory fits in maxBytes, keeping keep
+    void evict(const std::string &keep);
+
+public:
+    static constexpr std::uint32_t formatVersion = 1;
+
+    SeamMapCache(const std::string &cacheDirectory, const std::uint64_t &sizeLimit);
+
+    // FNV-1a over bytes, continuing from seed so several buffers can be hashed into one key
+    static std::uint64_t hash(const void *bytes, const std::size_t &size,
+                              const std::uint64_t &seed = 14695981039346656037ull);
+
+    // Maps the entry for key if it exists, matches the image size, records at least numSeams seams and
+    // removes every one of them once per row, marking it as the most recently used. Returns null otherwise
+    std::unique_ptr<MappedFile> find(const std::uint64_t &key, const int &width, const int &height,
+                                     const int &numSeams);
+
+    // Header and seam numbers of an entry returned by find
+    static const SeamMapHeader &header(const MappedFile &entry);
+
+    static const void *indices(const MappedFile &entry);
+
+    // Writes the first numSeams seams of seamIndexMap under key, then evicts old entries over the
+    // size limit. Returns false if the entry could not be written
+    bool store(const std::uint64_t &key, const Image<int> &seamIndexMap, const int &numSeams);
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*
+    ThreadPool.hpp
+
+    Persistent worker threads and a spinning barrier for the parallel carving stages.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef INCLUDED_THREADPOOL_HPP
+#define INCLUDED_THREADPOOL_HPP
+
+// Fixed set of threads that sleep between jobs, so carving many seams never spawns threads. A pool can
+// also be open to threads lent by others, which join it while it is in use and take part in every run
+// from the next admit() on
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+
+    // Threads taking part in runs besides the caller. Threads that joined an open pool since the last
+    // admit() wait for the one after it
+    int numWorkers;
+    int numJoined = 0;
+    int maxJoined = 0;
+    int joinedLeft = 0;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    // The job of the current run and how to call it, kept as a plain function pointer rather than a
+    // std::function so that starting a run never allocates
+    void (*task)(const void *, int) = nullptr;
+    const void *taskJob = nullptr;
+    unsigned long generation = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    void workerLoop(const int &index, unsigned long seen)
+    {
+        for (;;)
+        {
+            void (*current)(const void *, int);
+            const void *currentJob;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen; });
+
+                if (stopping)
+                    return;
+
+                seen = generation;
+                if (index > numWorkers)
+                    continue;
+
+                current = task;
+                currentJob = taskJob;
+            }
+
+            current(currentJob, index);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                finished.notify_all();
+        }
+    }
+
+public:
+    // Marks a pool that only runs on threads joining it
+    struct Open
+    {
+    };
+
+    explicit ThreadPool(const int &numThreads) : numWorkers(std::max(numThreads, 1) - 1)
+    {
+        for (int i = 1; i < numThreads; ++i)
+            workers.emplace_back([this, i]() { workerLoop(i, 0); });
+    }
+
+    // Pool with no threads of its own, which up to maxThreads - 1 others may join
+    ThreadPool(const int &maxThreads, Open) : numWorkers(0), maxJoined(std::max(maxThreads, 1) - 1) {}
+
+    ~ThreadPool()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+        wake.notify_all();
+
+        // Joined threads may not have started serving yet, and must have left before the pool goes away
+        finished.wait(lock, [&]() { return joinedLeft == 0; });
+        lock.unlock();
+
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Whether an open pool can take another thread
+    bool open()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !stopping && numJoined < maxJoined;
+    }
+
+    // Reserves a thread index of an open pool for the calling thread, which must then pass it to serve().
+    // Returns 0 if the pool is full or being destroyed
+    int join(unsigned long &joinedAt)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (stopping || numJoined == maxJoined)
+            return 0;
+
+        joinedLeft++;
+        joinedAt = generation;
+        return ++numJoined;
+    }
+
+    // Runs the jobs of thread index, from the first run after the pool admits it, until the pool is destroyed
+    void serve(const int &index, const unsigned long &joinedAt)
+    {
+        workerLoop(index, joinedAt);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--joinedLeft == 0)
+            finished.notify_all();
+    }
+
+    // Lets every thread that joined so far take part in the following runs. Only the thread calling run()
+    // may call it, and never during a run, since size() must not change under a job
+    void admit()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (maxJoined > 0)
+            numWorkers = numJoined;
+    }
+
+    // Number of threads taking part in run(), including the caller
+    int size() const { return numWorkers + 1; }
+
+    // Runs job(index) once on every thread, the calling thread taking index 0, and waits for all of them
+    template <typename Job>
+    void run(const Job &job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = [](const void *context, int index) { (*static_cast<const Job *>(context))(index); };
+            taskJob = &job;
+            pending = numWorkers;
+            ++generation;
+        }
+
+        wake.notify_all();
+        job(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&]() { return pending == 0; });
+    }
+};
+
+// Reusable barrier for synchronising threads between DP rows. Spins briefly, then yields so an
+// oversubscribed machine still makes progress
+class SpinBarrier
+{
+private:
+    const int numThreads;
+    std::atomic<int> waiting{0};
+    std::atomic<unsigned> generation{0};
+
+public:
+    explicit SpinBarrier(const int &threads) : numThreads(threads) {}
+
+    void wait()
+    {
+        const unsigned current = generation.load(std::memory_order_acquire);
+
+        // The last thread to arrive releases everyone else
+        if (waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == numThreads)
+        {
+            waiting.store(0, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+
+        for (int spins = 0; generation.load(std::memory_order_acquire) == current; ++spins)
+        {
+            if (spins > 1000)
+                std::this_thread::yield();
+        }
+    }
+};
+
+#endif
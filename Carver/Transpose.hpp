@@ -0,0 +1,295 @@
+/*
+    Transpose.hpp
+
+    Cache-blocked transpose kernels for Image buffers.
+*/
+
+#include "Image.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef INCLUDED_TRANSPOSE_HPP
+#define INCLUDED_TRANSPOSE_HPP
+
+namespace transposeKernels
+{
+    // 32 x 32 tiles keep both the source and destination tile in L1, even for int samples
+    const int tileSize = 32;
+
+    // Side of the square block handled by a SIMD micro-kernel, 0 if there is none for T
+    template <typename T>
+    constexpr int microBlockSize()
+    {
+#ifdef __SSE2__
+        if (sizeof(T) == 1)
+            return 16;
+        if (sizeof(T) == 2)
+            return 8;
+        if (sizeof(T) == 4)
+            return 4;
+#endif
+        return 0;
+    }
+
+#ifdef __SSE2__
+    // Transposes a 16 x 16 block of bytes with four rounds of interleaving
+    inline void transposeMicroBlock(const uint8_t *src, const int &srcStride, uint8_t *dst, const int &dstStride)
+    {
+        __m128i a[16], b[16];
+
+        for (int i = 0; i < 16; ++i)
+            a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + static_cast<std::ptrdiff_t>(i) * srcStride));
+
+        // Pairs of rows, bytes interleaved
+        for (int i = 0; i < 8; ++i)
+        {
+            b[2 * i] = _mm_unpacklo_epi8(a[2 * i], a[2 * i + 1]);
+            b[2 * i + 1] = _mm_unpackhi_epi8(a[2 * i], a[2 * i + 1]);
+        }
+
+        // Groups of four rows
+        for (int i = 0; i < 4; ++i)
+        {
+            a[4 * i] = _mm_unpacklo_epi16(b[4 * i], b[4 * i + 2]);
+            a[4 * i + 1] = _mm_unpackhi_epi16(b[4 * i], b[4 * i + 2]);
+            a[4 * i + 2] = _mm_unpacklo_epi16(b[4 * i + 1], b[4 * i + 3]);
+            a[4 * i + 3] = _mm_unpackhi_epi16(b[4 * i + 1], b[4 * i + 3]);
+        }
+
+        // Groups of eight rows
+        for (int i = 0; i < 2; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                b[8 * i + 2 * j] = _mm_unpacklo_epi32(a[8 * i + j], a[8 * i + j + 4]);
+                b[8 * i + 2 * j + 1] = _mm_unpackhi_epi32(a[8 * i + j], a[8 * i + j + 4]);
+            }
+        }
+
+        // Whole columns
+        for (int j = 0; j < 8; ++j)
+        {
+            a[2 * j] = _mm_unpacklo_epi64(b[j], b[j + 8]);
+            a[2 * j + 1] = _mm_unpackhi_epi64(b[j], b[j + 8]);
+        }
+
+        for (int i = 0; i < 16; ++i)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + static_cast<std::ptrdiff_t>(i) * dstStride), a[i]);
+    }
+
+    // Transposes an 8 x 8 block of 16-bit samples
+    inline void transposeMicroBlock(const uint16_t *src, const int &srcStride, uint16_t *dst, const int &dstStride)
+    {
+        __m128i a[8], b[8];
+
+        for (int i = 0; i < 8; ++i)
+            a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + static_cast<std::ptrdiff_t>(i) * srcStride));
+
+        for (int i = 0; i < 4; ++i)
+        {
+            b[2 * i] = _mm_unpacklo_epi16(a[2 * i], a[2 * i + 1]);
+            b[2 * i + 1] = _mm_unpackhi_epi16(a[2 * i], a[2 * i + 1]);
+        }
+
+        for (int i = 0; i < 2; ++i)
+        {
+            a[4 * i] = _mm_unpacklo_epi32(b[4 * i], b[4 * i + 2]);
+            a[4 * i + 1] = _mm_unpackhi_epi32(b[4 * i], b[4 * i + 2]);
+            a[4 * i + 2] = _mm_unpacklo_epi32(b[4 * i + 1], b[4 * i + 3]);
+            a[4 * i + 3] = _mm_unpackhi_epi32(b[4 * i + 1], b[4 * i + 3]);
+        }
+
+        for (int j = 0; j < 4; ++j)
+        {
+            b[2 * j] = _mm_unpacklo_epi64(a[j], a[j + 4]);
+            b[2 * j + 1] = _mm_unpackhi_epi64(a[j], a[j + 4]);
+        }
+
+        for (int i = 0; i < 8; ++i)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + static_cast<std::ptrdiff_t>(i) * dstStride), b[i]);
+    }
+
+    // Transposes a 4 x 4 block of 32-bit samples
+    template <typename T, typename = std::enable_if_t<sizeof(T) == 4>>
+    inline void transposeMicroBlock(const T *src, const int &srcStride, T *dst, const int &dstStride)
+    {
+        __m128i a[4], b[4];
+
+        for (int i = 0; i < 4; ++i)
+            a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + static_cast<std::ptrdiff_t>(i) * srcStride));
+
+        b[0] = _mm_unpacklo_epi32(a[0], a[1]);
+        b[1] = _mm_unpackhi_epi32(a[0], a[1]);
+        b[2] = _mm_unpacklo_epi32(a[2], a[3]);
+        b[3] = _mm_unpackhi_epi32(a[2], a[3]);
+
+        a[0] = _mm_unpacklo_epi64(b[0], b[2]);
+        a[1] = _mm_unpackhi_epi64(b[0], b[2]);
+        a[2] = _mm_unpacklo_epi64(b[1], b[3]);
+        a[3] = _mm_unpackhi_epi64(b[1], b[3]);
+
+        for (int i = 0; i < 4; ++i)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + static_cast<std::ptrdiff_t>(i) * dstStride), a[i]);
+    }
+#endif
+
+    // Copies src rows [rowStart, rowEnd) x columns [colStart, colEnd) transposed into dst, one pixel at a
+    // time. Samples are taken to be interleaved unless there is only one channel
+    template <int NumChannels, typename T>
+    void transposeScalar(const Image<T> &src, Image<T> &dst, const int &rowStart, const int &rowEnd,
+                         const int &colStart, const int &colEnd)
+    {
+        for (int j = colStart; j < colEnd; ++j)
+        {
+            T *dstRow = dst.row(j);
+
+            for (int i = rowStart; i < rowEnd; ++i)
+            {
+                const T *pixel = src.row(i) + j * NumChannels;
+
+                for (int k = 0; k < NumChannels; ++k)
+                    dstRow[i * NumChannels + k] = pixel[k];
+            }
+        }
+    }
+
+    // Dispatches to a fixed channel count so the per-pixel copy is unrolled
+    template <typename T>
+    void transposeScalar(const Image<T> &src, Image<T> &dst, const int &rowStart, const int &rowEnd,
+                         const int &colStart, const int &colEnd)
+    {
+        if (src.channels == 1)
+            transposeScalar<1>(src, dst, rowStart, rowEnd, colStart, colEnd);
+        else if (!planarLayout && src.channels == 3)
+            transposeScalar<3>(src, dst, rowStart, rowEnd, colStart, colEnd);
+        else
+        {
+            for (int j = colStart; j < colEnd; ++j)
+                for (int i = rowStart; i < rowEnd; ++i)
+                    for (int k = 0; k < src.channels; ++k)
+                        dst.at(j, i, k) = src.at(i, j, k);
+        }
+    }
+
+    // Transposes one tile, using the micro-kernel on every full block it contains
+    template <typename T>
+    void transposeTile(const Image<T> &src, Image<T> &dst, const int &rowStart, const int &rowEnd,
+                       const int &colStart, const int &colEnd)
+    {
+        constexpr int block = microBlockSize<T>();
+
+        if constexpr (block > 0)
+        {
+            if (src.channels == 1)
+            {
+                const int blockRowEnd = rowStart + (rowEnd - rowStart) / block * block;
+                const int blockColEnd = colStart + (colEnd - colStart) / block * block;
+
+                for (int i = rowStart; i < blockRowEnd; i += block)
+                    for (int j = colStart; j < blockColEnd; j += block)
+                        transposeMicroBlock(src.row(i) + j, src.stride, dst.row(j) + i, dst.stride);
+
+                // Leftover strips along the right and bottom edges of the tile
+                transposeScalar(src, dst, rowStart, blockRowEnd, blockColEnd, colEnd);
+                transposeScalar(src, dst, blockRowEnd, rowEnd, colStart, colEnd);
+                return;
+            }
+        }
+
+        transposeScalar(src, dst, rowStart, rowEnd, colStart, colEnd);
+    }
+}
+
+// Writes the transpose of src into dst, reusing dst's allocation when it is large enough
+template <typename T>
+void transposeImage(const Image<T> &src, Image<T> &dst)
+{
+    using namespace transposeKernels;
+
+    dst.channels = src.channels;
+    dst.reshape(src.height, src.width);
+
+    for (int i = 0; i < src.height; i += tileSize)
+    {
+        for (int j = 0; j < src.width; j += tileSize)
+        {
+            transposeTile(src, dst, i, std::min(i + tileSize, src.height), j, std::min(j + tileSize, src.width));
+        }
+    }
+}
+
+// Transposes an image inside its own allocation. The buffer is first widened, if needed, to hold a
+// square as large as the longer side, after which tiles on either side of the diagonal are swapped.
+// Images over external samples cannot be widened, so they are transposed into an allocation of their own
+template <typename T>
+void transposeImageInPlace(Image<T> &image)
+{
+    using namespace transposeKernels;
+
+    // Planes would each need widening to a square of their own, so planar color images go through a copy,
+    // as do images whose samples the image does not own
+    if ((planarLayout && image.channels > 1) || image.external)
+    {
+        Image<T> transposed;
+        transposeImage(image, transposed);
+        image = std::move(transposed);
+        return;
+    }
+
+    const int numCols = image.width;
+    const int numRows = image.height;
+    const int numChannels = image.channels;
+    const int side = std::max(numCols, numRows);
+
+    if (image.stride < side * numChannels)
+    {
+        const int oldStride = image.stride;
+        image.stride = side * numChannels;
+        image.data.resize(std::max(image.data.size(), static_cast<std::size_t>(side) * image.stride));
+
+        // Rows only ever move towards the end of the buffer, so move the last one first
+        for (int i = numRows - 1; i > 0; --i)
+        {
+            const T *oldRow = image.data.data() + static_cast<std::size_t>(i) * oldStride;
+            std::copy_backward(oldRow, oldRow + numCols * numChannels, image.row(i) + numCols * numChannels);
+        }
+    }
+    else if (image.data.size() < static_cast<std::size_t>(side) * image.stride)
+    {
+        image.data.resize(static_cast<std::size_t>(side) * image.stride);
+    }
+
+    for (int rowStart = 0; rowStart < side; rowStart += tileSize)
+    {
+        for (int colStart = rowStart; colStart < side; colStart += tileSize)
+        {
+            const int rowEnd = std::min(rowStart + tileSize, side);
+            const int colEnd = std::min(colStart + tileSize, side);
+
+            for (int i = rowStart; i < rowEnd; ++i)
+            {
+                for (int j = std::max(colStart, i + 1); j < colEnd; ++j)
+                {
+                    T *upper = image.row(i) + j * numChannels;
+                    T *lower = image.row(j) + i * numChannels;
+
+                    for (int k = 0; k < numChannels; ++k)
+                        std::swap(upper[k], lower[k]);
+                }
+            }
+        }
+    }
+
+    image.width = numRows;
+    image.height = numCols;
+}
+
+#endif
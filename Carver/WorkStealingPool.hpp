@@ -0,0 +1,223 @@
+/*
+    WorkStealingPool.hpp
+
+    Worker threads with a task deque each, for running many independent carves at once.
+*/
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef INCLUDED_WORKSTEALINGPOOL_HPP
+#define INCLUDED_WORKSTEALINGPOOL_HPP
+
+// Tasks go to the workers' deques in turn. A worker runs its own tasks newest first and, once it has
+// none left, steals the oldest task of another worker. Workers that find nothing to steal either, join
+// the thread pool of a task that asked for help, or sleep until there is a task or a pool to join
+class WorkStealingPool
+{
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> queues;
+    std::vector<std::thread> threads;
+
+    // Guards everything below, the deques having locks of their own
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::vector<ThreadPool *> helped;
+    int queued = 0;
+    int unfinished = 0;
+    int nextQueue = 0;
+    bool stopping = false;
+
+    bool popOwn(const int &index, std::function<void()> &task)
+    {
+        Worker &worker = *queues[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        if (worker.tasks.empty())
+            return false;
+
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    // Tries every other worker once, starting after this one so thieves spread over their victims
+    bool steal(const int &index, std::function<void()> &task)
+    {
+        const int numQueues = static_cast<int>(queues.size());
+
+        for (auto n = 1; n < numQueues; ++n)
+        {
+            Worker &victim = *queues[(index + n) % numQueues];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+
+            if (victim.tasks.empty())
+                continue;
+
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+
+        return false;
+    }
+
+    // Open pool of a task that can take another thread, if any
+    ThreadPool *openPool()
+    {
+        for (auto pool : helped)
+        {
+            if (pool->open())
+                return pool;
+        }
+
+        return nullptr;
+    }
+
+    void workerLoop(const int &index)
+    {
+        std::function<void()> task;
+
+        for (;;)
+        {
+            if (popOwn(index, task) || steal(index, task))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --queued;
+                }
+
+                task();
+                task = nullptr;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--unfinished == 0)
+                    finished.notify_all();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+
+            // Tasks submitted since the deques were checked are picked up before going to sleep
+            if (queued > 0)
+                continue;
+
+            if (stopping)
+                return;
+
+            wake.wait(lock, [&]() { return stopping || queued > 0 || this->openPool(); });
+
+            // The pool stays registered, and so alive, until after join() has counted this thread in
+            ThreadPool *pool = stopping || queued > 0 ? nullptr : this->openPool();
+            unsigned long joinedAt = 0;
+            const int poolIndex = pool ? pool->join(joinedAt) : 0;
+
+            if (poolIndex == 0)
+                continue;
+
+            lock.unlock();
+            pool->serve(poolIndex, joinedAt);
+        }
+    }
+
+public:
+    explicit WorkStealingPool(const int &numThreads)
+    {
+        for (int i = 0; i < std::max(numThreads, 1); ++i)
+            queues.push_back(std::make_unique<Worker>());
+
+        for (int i = 0; i < static_cast<int>(queues.size()); ++i)
+            threads.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    ~WorkStealingPool()
+    {
+        this->wait();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    int size() const { return static_cast<int>(threads.size()); }
+
+    // Queues task on the next worker in turn and wakes a sleeping worker to take it
+    void submit(std::function<void()> task)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        {
+            Worker &worker = *queues[nextQueue];
+            std::lock_guard<std::mutex> queueLock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+
+        nextQueue = (nextQueue + 1) % static_cast<int>(queues.size());
+        ++queued;
+        ++unfinished;
+        wake.notify_all();
+    }
+
+    // Waits for every task submitted so far, and every task they submitted, to finish
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&]() { return unfinished == 0; });
+    }
+
+    // Thread pool of a task, which workers with nothing else to do join while the task holds it. Leaving
+    // it open to them until the task is done means workers that only go idle half way through still help
+    class Helpers
+    {
+    private:
+        WorkStealingPool &owner;
+        ThreadPool pool;
+
+    public:
+        Helpers(WorkStealingPool &workers, const int &maxThreads) : owner(workers), pool(maxThreads, ThreadPool::Open())
+        {
+            std::lock_guard<std::mutex> lock(owner.mutex);
+            owner.helped.push_back(&pool);
+            owner.wake.notify_all();
+        }
+
+        ~Helpers()
+        {
+            std::lock_guard<std::mutex> lock(owner.mutex);
+            owner.helped.erase(std::find(owner.helped.begin(), owner.helped.end(), &pool));
+        }
+
+        Helpers(const Helpers &) = delete;
+
+        Helpers &operator=(const Helpers &) = delete;
+
+        ThreadPool &threads() { return pool; }
+    };
+};
+
+#endif
@@ -0,0 +1,75 @@
+/*
+    arena_bench.cpp
+
+    Carves one image several times with the same carver and reports the time and heap allocations
+    of every carve, overall and inside the seam loops. Only the first carve should have to grow the
+    carver's buffers; the seam loops should never allocate.
+    Usage: arena_bench <image> <vertical seams> <horizontal seams> [carves] [options...]
+*/
+
+#include "AllocationCounter.hpp"
+#include "ImageCarver.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <image> <vertical seams> <horizontal seams> [carves] [options...]" << endl;
+        return 1;
+    }
+
+    // Everything but the carve count is handed on to the carver
+    std::vector<char *> carveArgs(argv, argv + 4);
+    int numCarves = 5;
+    int firstOption = 4;
+
+    if (argc > 4 && std::strncmp(argv[4], "--", 2) != 0)
+    {
+        numCarves = std::max(1, atoi(argv[4]));
+        firstOption = 5;
+    }
+
+    carveArgs.insert(carveArgs.end(), argv + firstOption, argv + argc);
+
+    if (!allocationCounter::enabled())
+        cout << "Allocations are not counted, configure with -DCARVE_COUNT_ALLOCATIONS=ON to count them" << endl;
+
+    cout << "Carving " << argv[2] << " vertical and " << argv[3] << " horizontal seams from " << argv[1] << " "
+         << numCarves << " times" << endl;
+
+    return withImageCarver<1, 3>(argv[1], [&](auto &carver) {
+        for (auto n = 0; n < numCarves; ++n)
+        {
+            // The carver reports on cout, which is muted while it runs
+            std::ostringstream sink;
+            std::streambuf *console = cout.rdbuf(sink.rdbuf());
+
+            const std::uint64_t allocationsBefore = allocationCounter::count();
+            auto start = std::chrono::steady_clock::now();
+            const int status = carver.carve(static_cast<int>(carveArgs.size()), carveArgs.data());
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            const std::uint64_t allocations = allocationCounter::count() - allocationsBefore;
+
+            cout.rdbuf(console);
+
+            if (status != 0)
+                return status;
+
+            cout << "carve " << n + 1 << ": " << elapsed.count() * 1000 << " ms, " << allocations << " allocations, "
+                 << carver.seamLoopAllocations() << " in the seam loops" << endl;
+        }
+
+        return 0;
+    });
+}
@@ -0,0 +1,80 @@
+/*
+    batch_bench.cpp
+
+    Times carving an image with several batch sizes and reports how far each drifts from exact
+    seam removal, as the energy of the removed pixels relative to batches of one.
+    Usage: batch_bench <image> <vertical seams> <horizontal seams> [batch sizes...]
+*/
+
+#include "ImageCarver.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <image> <vertical seams> <horizontal seams> [batch sizes...]" << endl;
+        return 1;
+    }
+
+    std::vector<int> batchSizes = {1, 4, 16, 64};
+
+    if (argc > 4)
+    {
+        batchSizes.assign(1, 1);
+        for (auto n = 4; n < argc; ++n)
+            batchSizes.push_back(std::max(1, atoi(argv[n])));
+    }
+
+    cout << "Carving " << argv[2] << " vertical and " << argv[3] << " horizontal seams from " << argv[1] << endl;
+
+    double exactSeconds = 0;
+    std::uint64_t exactEnergy = 0;
+
+    for (auto batchSize : batchSizes)
+    {
+        std::uint64_t energy = 0;
+
+        // The carver reports on cout, which is muted while it runs
+        std::ostringstream sink;
+        std::streambuf *console = cout.rdbuf(sink.rdbuf());
+
+        auto start = std::chrono::steady_clock::now();
+        const int status = withImageCarver<1, 3>(argv[1], [&](auto &carver) {
+            carver.setBatchSize(batchSize);
+            const int carved = carver.carve(4, argv);
+            energy = carver.removedEnergy();
+            return carved;
+        });
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        cout.rdbuf(console);
+
+        if (status != 0)
+            return status;
+
+        if (batchSize == 1)
+        {
+            exactSeconds = elapsed.count();
+            exactEnergy = energy;
+        }
+
+        const double drift = exactEnergy ? 100.0 * (static_cast<double>(energy) / exactEnergy - 1) : 0;
+
+        cout << "batch " << batchSize << ": " << elapsed.count() * 1000 << " ms, speedup " << exactSeconds / elapsed.count()
+             << "x, removed energy " << energy << " (" << (drift >= 0 ? "+" : "") << drift << "%)" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+    carve_api_test.c
+
+    Carves a generated image through the C interface with valid settings, with modes that cannot be
+    combined and with settings out of range, which must be refused without touching the pixels like
+    the command line refuses them, and without a context. Written in C so the header is also checked to
+    compile as C.
+    Usage: carve_api_test
+*/
+
+#include "CarveApi.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+enum
+{
+    width = 48,
+    height = 32,
+    targetWidth = 40,
+    targetHeight = 28
+};
+
+static uint8_t pixels[height][width * 3];
+static uint8_t original[height][width * 3];
+static uint8_t output[targetHeight][targetWidth * 3];
+
+static int failures = 0;
+
+// Carves a fresh copy of the image in place with channels samples per pixel and checks the status, and
+// that a refused carve left the pixels alone
+static void expect(carve_context *context, const char *name, const int channels, const int expected)
+{
+    memcpy(pixels, original, sizeof(pixels));
+
+    const int status = carve_u8(context, &pixels[0][0], width, height, sizeof(pixels[0]), channels, targetWidth,
+                                targetHeight);
+    const int untouched = memcmp(pixels, original, sizeof(pixels)) == 0;
+    const int passed = status == expected && (expected == CARVE_OK || untouched);
+
+    printf("%s %s: status %d%s\n", passed ? "ok  " : "FAIL", name, status,
+           expected != CARVE_OK && !untouched ? ", pixels changed" : "");
+    failures += !passed;
+}
+
+// Same through the overload writing to another buffer
+static void expectInto(carve_context *context, const char *name, const int expected)
+{
+    const int status = carve_u8_into(context, &original[0][0], width, height, sizeof(original[0]), 3, &output[0][0],
+                                     sizeof(output[0]), targetWidth, targetHeight);
+    const int passed = status == expected;
+
+    printf("%s %s: status %d\n", passed ? "ok  " : "FAIL", name, status);
+    failures += !passed;
+}
+
+// Puts every setting back to its default
+static void resetSettings(carve_context *context)
+{
+    carve_set_threads(context, 0);
+    carve_set_batch_size(context, 1);
+    carve_set_deferred_removal(context, -1);
+    carve_set_compact_dp(context, 0);
+    carve_set_pyramid_search(context, 0, 4);
+}
+
+int main(void)
+{
+    carve_context *context = carve_create();
+    int i, j;
+
+    if (!context)
+    {
+        fprintf(stderr, "Could not create a context\n");
+        return 1;
+    }
+
+    for (i = 0; i < height; ++i)
+    {
+        for (j = 0; j < width * 3; ++j)
+            original[i][j] = (uint8_t)((i * 7 + j * 13 + (i * j) % 11) % 256);
+    }
+
+    expect(context, "default settings", 3, CARVE_OK);
+    expect(context, "default settings, grey", 1, CARVE_OK);
+
+    carve_set_batch_size(context, 4);
+    expect(context, "batch", 3, CARVE_OK);
+    carve_set_compact_dp(context, 1);
+    expect(context, "batch and compact DP", 3, CARVE_INVALID_ARGUMENT);
+    expectInto(context, "batch and compact DP into a buffer", CARVE_INVALID_ARGUMENT);
+    resetSettings(context);
+
+    carve_set_batch_size(context, 4);
+    carve_set_pyramid_search(context, 2, 4);
+    expect(context, "batch and pyramid", 3, CARVE_INVALID_ARGUMENT);
+    resetSettings(context);
+
+    carve_set_deferred_removal(context, 0);
+    carve_set_compact_dp(context, 1);
+    expect(context, "deferred removal and compact DP", 1, CARVE_INVALID_ARGUMENT);
+    resetSettings(context);
+
+    carve_set_batch_size(context, 0);
+    expect(context, "batch of 0", 3, CARVE_INVALID_ARGUMENT);
+    resetSettings(context);
+
+    carve_set_pyramid_search(context, 2, 0);
+    expect(context, "band of 0", 3, CARVE_INVALID_ARGUMENT);
+    resetSettings(context);
+
+    carve_set_deferred_removal(context, -2);
+    expect(context, "deferred interval below -1", 3, CARVE_INVALID_ARGUMENT);
+    resetSettings(context);
+
+    carve_set_threads(context, -1);
+    expect(context, "negative threads", 3, CARVE_INVALID_ARGUMENT);
+    resetSettings(context);
+
+    // Strides past INT_MAX samples cannot be mapped, so must be refused before any row is read
+    if (carve_u8(context, &pixels[0][0], width, height, (size_t)INT_MAX + 1, 3, targetWidth, targetHeight) !=
+            CARVE_INVALID_ARGUMENT ||
+        carve_u8_into(context, &original[0][0], width, height, sizeof(original[0]), 3, &output[0][0],
+                      (size_t)INT_MAX + 1, targetWidth, targetHeight) != CARVE_INVALID_ARGUMENT)
+    {
+        printf("FAIL stride past INT_MAX: accepted\n");
+        failures++;
+    }
+    else
+        printf("ok   stride past INT_MAX: refused\n");
+
+    // Without a context nothing is set and nothing is carved
+    resetSettings(NULL);
+    carve_set_batch_size(NULL, 4);
+    expect(NULL, "no context", 3, CARVE_INVALID_ARGUMENT);
+
+    expect(context, "default settings again", 3, CARVE_OK);
+    expectInto(context, "default settings into a buffer", CARVE_OK);
+
+    carve_destroy(context);
+    return failures == 0 ? 0 : 1;
+}
@@ -2,14 +2,25 @@
     carve_seam.cpp
 */
 
+#include "BatchCarve.hpp"
 #include "ImageCarver.hpp"
 
+#include <cstring>
 #include <iostream>
 #include <fstream>
 
 int main(int argc, char *argv[])
 {
-    ImageCarver carverClass;
-    carverClass.carve(argc, argv);
-    return 0;
+    // carve_seam batch ... carves a whole directory or manifest at once
+    if (argc > 1 && std::strcmp(argv[1], "batch") == 0)
+        return carveBatch<1, 3>(argc, argv);
+
+    if (argc < 4)
+    {
+        ImageCarverBase::printUsage(argv[0]);
+        return 1;
+    }
+
+    // Grey and color images, with 8- or 16-bit samples
+    return withImageCarver<1, 3>(argv[1], [&](auto &carverClass) { return carverClass.carve(argc, argv); });
 }
@@ -0,0 +1,79 @@
+/*
+    dp_bench.cpp
+
+    Times the vertical cumulative energy DP with the row-barrier and tiled schedules
+    over several aspect ratios of the same pixel count.
+    Usage: dp_bench [threads] [megapixels]
+*/
+
+#include "ImageCarverBase.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int repetitions = 5;
+
+    double bestSeconds(ImageCarverBase &carver, const Image<Energy> &energy, Image<Energy> &cEnergy)
+    {
+        double best = 1e30;
+
+        for (auto r = 0; r < repetitions; ++r)
+        {
+            auto start = std::chrono::steady_clock::now();
+            carver.vertCumulativeEnergy(energy, cEnergy);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+
+        return best;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const int threads = argc > 1 ? atoi(argv[1]) : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const double megapixels = argc > 2 ? atof(argv[2]) : 8;
+    const double aspects[] = {16, 4, 1, 0.25, 1.0 / 16, 1.0 / 64};
+
+    cout << "Vertical cumulative energy, " << energyKernels::instructionSet() << " kernels, " << threads << " threads, best of "
+         << repetitions << endl;
+
+    ImageCarverBase carver;
+
+    for (auto aspect : aspects)
+    {
+        // aspect is width / height
+        const int numCols = static_cast<int>(std::sqrt(megapixels * 1e6 * aspect));
+        const int numRows = static_cast<int>(megapixels * 1e6 / numCols);
+
+        Image<Energy> energy(numCols, numRows);
+        for (std::size_t n = 0; n < energy.data.size(); ++n)
+            energy.data[n] = static_cast<Energy>(n * 2654435761u >> 20) & 1023;
+
+        Image<Energy> serial, rows, tiles;
+
+        carver.setThreads(1);
+        const double serialSeconds = bestSeconds(carver, energy, serial);
+
+        carver.setThreads(threads);
+        carver.setSchedule(ImageCarverBase::Schedule::Rows);
+        const double rowSeconds = bestSeconds(carver, energy, rows);
+
+        carver.setSchedule(ImageCarverBase::Schedule::Tiles);
+        const double tileSeconds = bestSeconds(carver, energy, tiles);
+
+        cout << numCols << " x " << numRows << ": serial " << serialSeconds * 1000 << " ms, rows "
+             << rowSeconds * 1000 << " ms, tiles " << tileSeconds * 1000 << " ms"
+             << (rows.data == serial.data && tiles.data == serial.data ? "" : "  RESULT MISMATCH") << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+    energy_update_test.cpp
+
+    Removes seams from grey and color versions of 8-bit PGM images, with 8 and 16-bit samples, and
+    checks after every seam that the energy matrix updated around it matches a full recomputation.
+    Seams are found by the DP or forced along and next to the borders, vertically and horizontally.
+    Usage: energy_update_test <image>...
+*/
+
+#include "ImageCarver.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+// Carver whose seams are removed one step at a time, comparing the energy matrix after each one
+template <typename PixelT, int Channels>
+class EnergyUpdateCheck : public ImageCarver<PixelT, Channels>
+{
+private:
+    Image<PixelT> image;
+    Image<Energy> energy;
+    Image<Energy> fresh;
+    Image<Energy> cumulative;
+    std::vector<int> seam;
+
+    // Entries of the updated energy matrix that differ from a full recomputation
+    int mismatches()
+    {
+        this->calculateEnergyMatrix(image, fresh);
+
+        if (energy.width != fresh.width || energy.height != fresh.height)
+            return fresh.width * fresh.height;
+
+        int count = 0;
+
+        for (auto i = 0; i < fresh.height; ++i)
+        {
+            for (auto j = 0; j < fresh.width; ++j)
+            {
+                if (energy.row(i)[j] != fresh.row(i)[j])
+                    count++;
+            }
+        }
+
+        return count;
+    }
+
+    // Seam n lies on line i (a row for vertical seams, a column for horizontal ones) of lineLength:
+    // found by the DP for two seams in five, otherwise on the first or last line or zigzagging next to it
+    static int forcedLine(const int &n, const int &i, const int &lineLength)
+    {
+        switch (n % 5)
+        {
+        case 1:
+            return 0;
+        case 2:
+            return lineLength - 1;
+        case 4:
+            return (n / 5) % 2 ? i % 2 : lineLength - 1 - i % 2;
+        default:
+            return -1;
+        }
+    }
+
+public:
+    // Fills the image with a variant of grey: channels offset from each other and 16-bit samples spread
+    // over the whole range
+    void load(const Image<std::uint8_t> &grey)
+    {
+        std::vector<PixelT> samples(static_cast<std::size_t>(grey.width) * Channels);
+
+        image.channels = Channels;
+        image.reshape(grey.width, grey.height);
+
+        for (auto i = 0; i < grey.height; ++i)
+        {
+            for (auto j = 0; j < grey.width; ++j)
+            {
+                for (auto k = 0; k < Channels; ++k)
+                {
+                    const int value = (grey.row(i)[j] + 85 * k + (i * j + k) % 7) % 256;
+                    samples[j * Channels + k] = static_cast<PixelT>(sizeof(PixelT) > 1 ? value * 257 : value);
+                }
+            }
+
+            image.setRow(i, samples.data());
+        }
+    }
+
+    // Removes numSeams vertical seams, then numSeams horizontal ones, and returns how many of them left a
+    // wrong energy matrix behind
+    int check(const int &numSeams)
+    {
+        int failures = 0;
+
+        this->calculateEnergyMatrix(image, energy);
+
+        for (auto n = 0; n < numSeams && image.width > 2; ++n)
+        {
+            if (forcedLine(n, 0, image.width) < 0)
+            {
+                this->vertCumulativeEnergy(energy, cumulative);
+                this->removeVerticalSeam(image, cumulative, seam);
+            }
+            else
+            {
+                seam.resize(image.height);
+
+                for (auto i = 0; i < image.height; ++i)
+                {
+                    seam[i] = forcedLine(n, i, image.width);
+                    image.shiftOutPixel(i, seam[i]);
+                }
+
+                image.width--;
+            }
+
+            this->updateVertEnergyMatrix(image, energy, seam);
+            failures += this->mismatches() > 0;
+        }
+
+        // A wrong vertical update is not carried over into the horizontal seams
+        this->calculateEnergyMatrix(image, energy);
+
+        for (auto n = 0; n < numSeams && image.height > 2; ++n)
+        {
+            if (forcedLine(n, 0, image.height) < 0)
+            {
+                this->horizCumulativeEnergy(energy, cumulative);
+                this->removeHorizontalSeam(image, cumulative, seam);
+            }
+            else
+            {
+                seam.resize(image.width);
+
+                for (auto j = 0; j < image.width; ++j)
+                    seam[j] = forcedLine(n, j, image.height);
+
+                image.shiftOutHorizontalSeam(seam);
+            }
+
+            this->updateHorizEnergyMatrix(image, energy, seam);
+            failures += this->mismatches() > 0;
+        }
+
+        return failures;
+    }
+};
+
+// Checks one sample type and channel count on grey, printing the result
+template <typename PixelT, int Channels>
+bool checkVariant(const char *fileName, const Image<std::uint8_t> &grey)
+{
+    const int numSeams = 30;
+    EnergyUpdateCheck<PixelT, Channels> carver;
+
+    carver.load(grey);
+    const int failures = carver.check(numSeams);
+
+    cout << (failures == 0 ? "ok   " : "FAIL ") << fileName << ", " << Channels << " channel(s) of "
+         << 8 * sizeof(PixelT) << " bits: " << failures << " seams left a wrong energy matrix" << endl;
+
+    return failures == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <image>..." << endl;
+        return 1;
+    }
+
+    bool passed = true;
+
+    for (auto n = 1; n < argc; ++n)
+    {
+        MappedFile file(argv[n]);
+        ImageCarverBase::pgmData imageData;
+        ImageCarver<std::uint8_t, 1> reader;
+        Image<std::uint8_t> grey;
+
+        if (!file.data() || !ImageCarverBase::readHeader(file, imageData) || imageData.channels != 1 ||
+            imageData.maxValue > 255 || !reader.readPixels(file, imageData, grey))
+        {
+            std::cerr << argv[n] << " is not a valid 8-bit PGM image" << endl;
+            return 1;
+        }
+
+        passed &= checkVariant<std::uint8_t, 1>(argv[n], grey);
+        passed &= checkVariant<std::uint8_t, 3>(argv[n], grey);
+        passed &= checkVariant<std::uint16_t, 1>(argv[n], grey);
+        passed &= checkVariant<std::uint16_t, 3>(argv[n], grey);
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/*
+    sample_depth_test.cpp
+
+    Checks that 16-bit images get the energies of the 8-bit images they were scaled from. A color
+    version of each 8-bit PGM image is stored in 16-bit samples scaled by 256, whose energies and carved
+    result must match those of the 8-bit image, and scaled by 1, whose energies must be the 8-bit ones
+    divided by 2^16 rather than losing every gradient below 256. Grey energies are plain sums and only
+    have to scale with the samples.
+    Usage: sample_depth_test <image> <vertical seams> <horizontal seams>
+*/
+
+#include "ImageCarver.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+// Carver exposing its energy pass
+template <typename PixelT, int Channels>
+class EnergyProbe : public ImageCarver<PixelT, Channels>
+{
+public:
+    using ImageCarver<PixelT, Channels>::calculateEnergyMatrix;
+};
+
+// Interleaved samples of a Channels version of grey, each multiplied by scale
+template <typename PixelT, int Channels>
+std::vector<PixelT> scaledSamples(const Image<std::uint8_t> &grey, const int &scale)
+{
+    std::vector<PixelT> samples(static_cast<std::size_t>(grey.width) * grey.height * Channels);
+
+    for (auto i = 0; i < grey.height; ++i)
+    {
+        for (auto j = 0; j < grey.width; ++j)
+        {
+            for (auto k = 0; k < Channels; ++k)
+            {
+                const int value = (grey.row(i)[j] + 85 * k) % 256;
+                samples[(static_cast<std::size_t>(i) * grey.width + j) * Channels + k] = static_cast<PixelT>(value * scale);
+            }
+        }
+    }
+
+    return samples;
+}
+
+// Energy matrix of the interleaved samples of a width x height image
+template <typename PixelT, int Channels>
+Image<Energy> energyOf(const std::vector<PixelT> &samples, const int &width, const int &height)
+{
+    EnergyProbe<PixelT, Channels> carver;
+    Image<PixelT> image;
+    Image<Energy> energy;
+
+    image.channels = Channels;
+    image.reshape(width, height);
+
+    for (auto i = 0; i < height; ++i)
+        image.setRow(i, samples.data() + static_cast<std::size_t>(i) * width * Channels);
+
+    carver.calculateEnergyMatrix(image, energy);
+    return energy;
+}
+
+// Whether expected(energy8) gives every entry of energy16, printing the outcome as name
+template <typename Expected>
+bool sameEnergies(const char *name, const Image<Energy> &energy8, const Image<Energy> &energy16, Expected expected)
+{
+    int mismatches = 0;
+
+    for (auto i = 0; i < energy8.height; ++i)
+    {
+        for (auto j = 0; j < energy8.width; ++j)
+        {
+            if (energy16.row(i)[j] != expected(energy8.row(i)[j]))
+                mismatches++;
+        }
+    }
+
+    cout << (mismatches == 0 ? "ok   " : "FAIL ") << name << ": " << mismatches << " energies differ" << endl;
+    return mismatches == 0;
+}
+
+// Carves the Channels version of grey at 8 bits and scaled by 256 at 16 bits, which must remove the same pixels
+template <int Channels>
+bool sameCarve(const Image<std::uint8_t> &grey, const int &targetWidth, const int &targetHeight)
+{
+    const std::vector<std::uint8_t> samples8 = scaledSamples<std::uint8_t, Channels>(grey, 1);
+    const std::vector<std::uint16_t> samples16 = scaledSamples<std::uint16_t, Channels>(grey, 256);
+    const std::size_t stride = static_cast<std::size_t>(grey.width) * Channels;
+
+    std::vector<std::uint8_t> output8(static_cast<std::size_t>(targetWidth) * targetHeight * Channels);
+    std::vector<std::uint16_t> output16(output8.size());
+
+    ImageCarver<std::uint8_t, Channels> carver8;
+    ImageCarver<std::uint16_t, Channels> carver16;
+
+    bool same = carver8.carve(samples8.data(), grey.width, grey.height, stride, output8.data(),
+                              static_cast<std::size_t>(targetWidth) * Channels, targetWidth, targetHeight) &&
+                carver16.carve(samples16.data(), grey.width, grey.height, stride, output16.data(),
+                               static_cast<std::size_t>(targetWidth) * Channels, targetWidth, targetHeight);
+
+    for (std::size_t n = 0; same && n < output8.size(); ++n)
+        same = output16[n] == output8[n] * 256;
+
+    cout << (same ? "ok   " : "FAIL ") << Channels << " channel(s): 16-bit carve " << (same ? "matches" : "differs from")
+         << " the 8-bit one" << endl;
+    return same;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <image> <vertical seams> <horizontal seams>" << endl;
+        return 1;
+    }
+
+    MappedFile file(argv[1]);
+    ImageCarverBase::pgmData imageData;
+    ImageCarver<std::uint8_t, 1> reader;
+    Image<std::uint8_t> grey;
+
+    if (!file.data() || !ImageCarverBase::readHeader(file, imageData) || imageData.channels != 1 ||
+        imageData.maxValue > 255 || !reader.readPixels(file, imageData, grey))
+    {
+        std::cerr << argv[1] << " is not a valid 8-bit PGM image" << endl;
+        return 1;
+    }
+
+    const int width = grey.width;
+    const int height = grey.height;
+
+    const Image<Energy> color8 = energyOf<std::uint8_t, 3>(scaledSamples<std::uint8_t, 3>(grey, 1), width, height);
+    const Image<Energy> color256 = energyOf<std::uint16_t, 3>(scaledSamples<std::uint16_t, 3>(grey, 256), width, height);
+    const Image<Energy> color1 = energyOf<std::uint16_t, 3>(scaledSamples<std::uint16_t, 3>(grey, 1), width, height);
+    const Image<Energy> grey8 = energyOf<std::uint8_t, 1>(scaledSamples<std::uint8_t, 1>(grey, 1), width, height);
+    const Image<Energy> grey256 = energyOf<std::uint16_t, 1>(scaledSamples<std::uint16_t, 1>(grey, 256), width, height);
+
+    bool passed = sameEnergies("16-bit color scaled by 256", color8, color256, [](Energy e) { return e; });
+    passed &= sameEnergies("16-bit color scaled by 1", color8, color1, [](Energy e) { return e >> 16; });
+    passed &= sameEnergies("16-bit grey scaled by 256", grey8, grey256, [](Energy e) { return e * 256; });
+
+    const int targetWidth = width - std::atoi(argv[2]);
+    const int targetHeight = height - std::atoi(argv[3]);
+
+    passed &= sameCarve<1>(grey, targetWidth, targetHeight);
+    passed &= sameCarve<3>(grey, targetWidth, targetHeight);
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/*
+    seam_allocation_test.cpp
+
+    Carves each image twice with the same carver in every mode and checks that no seam loop allocated,
+    on the first carve, which sizes the carver's buffers up front, or on the second, which reuses them.
+    Built with its own counting allocator, so it checks the seam loops whether or not the library counts.
+    Usage: seam_allocation_test <image> <vertical seams> <horizontal seams>...
+*/
+
+#include "AllocationCounter.hpp"
+#include "ImageCarver.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+// Carves argv[1] with options twice on one carver, printing the seam loop allocations of both carves
+bool carveTwice(char *argv[], const std::string &verticalSeams, const std::vector<std::string> &options)
+{
+    std::vector<std::string> args = {argv[0], argv[1], verticalSeams, argv[3]};
+    args.insert(args.end(), options.begin(), options.end());
+
+    std::vector<char *> carveArgs;
+    for (auto &arg : args)
+        carveArgs.push_back(&arg[0]);
+
+    std::string request;
+    for (auto n = 2; n < static_cast<int>(args.size()); ++n)
+        request += " " + args[n];
+
+    std::uint64_t allocations[2] = {0, 0};
+
+    const int status = withImageCarver<1, 3>(argv[1], [&](auto &carver) {
+        for (auto n = 0; n < 2; ++n)
+        {
+            // The carver reports on cout, which is muted while it runs
+            std::ostringstream sink;
+            std::streambuf *console = cout.rdbuf(sink.rdbuf());
+            const int result = carver.carve(static_cast<int>(carveArgs.size()), carveArgs.data());
+            cout.rdbuf(console);
+
+            if (result != 0)
+                return result;
+
+            allocations[n] = carver.seamLoopAllocations();
+        }
+
+        return 0;
+    });
+
+    const bool passed = status == 0 && allocations[0] == 0 && allocations[1] == 0;
+
+    cout << (passed ? "ok   " : "FAIL ") << argv[1] << request << ": ";
+    if (status != 0)
+        cout << "carve failed" << endl;
+    else
+        cout << allocations[0] << " and " << allocations[1] << " seam loop allocations" << endl;
+
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || (argc - 1) % 3 != 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " <image> <vertical seams> <horizontal seams>..." << endl;
+        return 1;
+    }
+
+    if (!allocationCounter::enabled())
+    {
+        std::cerr << "Allocations are not counted, so the seam loops cannot be checked" << endl;
+        return 1;
+    }
+
+    const std::vector<std::vector<std::string>> modes = {
+        {}, {"--threads=4"}, {"--deferred"}, {"--deferred=3"}, {"--batch=4"}, {"--compact-dp"}, {"--pyramid=2"},
+        {"--memory-budget=16"}};
+
+    bool passed = true;
+
+    for (auto n = 1; n + 2 < argc; n += 3)
+    {
+        char *carveArgv[] = {argv[0], argv[n], argv[n + 1], argv[n + 2]};
+
+        for (auto &options : modes)
+            passed &= carveTwice(carveArgv, argv[n + 1], options);
+
+        // Several widths share one seam index map
+        const std::string widths = std::string("1,") + argv[n + 1];
+        passed &= carveTwice(carveArgv, widths, {});
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+/*
+    seam_map_cache_test.cpp
+
+    Stores seam index maps in a cache directory, damages their seam numbers in place and checks that
+    the cache no longer returns them, as gathering a row from them would write past its end. Also has
+    several threads store different maps under one key at once, which must leave one of them whole.
+    Usage: seam_map_cache_test <directory>
+*/
+
+#include "SeamMapCache.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+namespace fs = std::filesystem;
+
+const int width = 40;
+const int height = 12;
+const int numSeams = 9;
+const std::uint64_t key = 0x5eed;
+
+// Map whose row i removes seam n at column (i + 3 n) % width and keeps the other pixels
+Image<int> seamIndexMap(const int &shift)
+{
+    Image<int> map(width, height);
+
+    for (auto i = 0; i < height; ++i)
+    {
+        std::fill(map.row(i), map.row(i) + width, numSeams);
+
+        for (auto n = 0; n < numSeams; ++n)
+            map.row(i)[(i + shift + 3 * n) % width] = n;
+    }
+
+    return map;
+}
+
+// Path of the only entry in directory
+std::string entryPath(const std::string &directory)
+{
+    for (auto &entry : fs::directory_iterator(directory))
+    {
+        if (entry.path().extension() == ".seammap")
+            return entry.path().string();
+    }
+
+    return "";
+}
+
+// Overwrites the 16-bit seam number of pixel j of row i in the entry
+void overwriteIndex(const std::string &path, const int &i, const int &j, const std::uint16_t &value)
+{
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(sizeof(SeamMapHeader) + (static_cast<std::size_t>(i) * width + j) * sizeof(value));
+    file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Stores a fresh entry, damages it with damage and checks whether find still returns it
+template <typename Damage>
+bool check(const std::string &directory, const char *name, const bool &expectFound, Damage damage)
+{
+    SeamMapCache cache(directory, 1 << 20);
+
+    if (!cache.store(key, seamIndexMap(0), numSeams))
+    {
+        cout << "FAIL " << name << ": could not store the entry" << endl;
+        return false;
+    }
+
+    damage(entryPath(directory));
+    const bool found = cache.find(key, width, height, numSeams) != nullptr;
+    const bool passed = found == expectFound;
+
+    cout << (passed ? "ok   " : "FAIL ") << name << ": entry " << (found ? "returned" : "refused") << endl;
+    return passed;
+}
+
+// Stores a different map under the same key from several threads at once, then checks that the entry
+// left behind is one of them rather than rows of several
+bool concurrentStores(const std::string &directory)
+{
+    const int numThreads = 8;
+    const int numStores = 20;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stored{true};
+
+    for (auto t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            SeamMapCache cache(directory, 1 << 20);
+            const Image<int> map = seamIndexMap(t);
+
+            for (auto n = 0; n < numStores; ++n)
+            {
+                if (!cache.store(key, map, numSeams))
+                    stored = false;
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    SeamMapCache cache(directory, 1 << 20);
+    const auto entry = cache.find(key, width, height, numSeams);
+    bool whole = false;
+
+    for (auto t = 0; entry && t < numThreads && !whole; ++t)
+    {
+        const Image<int> map = seamIndexMap(t);
+        const std::uint16_t *indices = static_cast<const std::uint16_t *>(SeamMapCache::indices(*entry));
+        whole = true;
+
+        for (auto i = 0; i < height; ++i)
+        {
+            for (auto j = 0; j < width; ++j)
+                whole &= indices[static_cast<std::size_t>(i) * width + j] == map.row(i)[j];
+        }
+    }
+
+    const bool passed = stored && whole;
+    cout << (passed ? "ok   " : "FAIL ") << "concurrent stores: "
+         << (!stored ? "a store failed" : whole ? "one map left whole" : "maps mixed") << endl;
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <directory>" << endl;
+        return 1;
+    }
+
+    const std::string directory = argv[1];
+    std::error_code error;
+    fs::remove_all(directory, error);
+
+    bool passed = check(directory, "intact", true, [](const std::string &) {});
+
+    // Row 3 keeps one pixel too many, removing seam 0 nowhere
+    passed &= check(directory, "seam missing from a row", false,
+                    [](const std::string &path) { overwriteIndex(path, 3, 3, numSeams); });
+
+    // Row 5 removes seam 0 twice and seam 1 not at all
+    passed &= check(directory, "seam removed twice in a row", false,
+                    [](const std::string &path) { overwriteIndex(path, 5, 8, 0); });
+
+    passed &= check(directory, "seam number out of range", false,
+                    [](const std::string &path) { overwriteIndex(path, height - 1, 0, numSeams + 1); });
+
+    passed &= concurrentStores(directory);
+
+    return passed ? 0 : 1;
+}
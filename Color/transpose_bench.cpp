@@ -0,0 +1,142 @@
+/*
+    transpose_bench.cpp
+
+    Times the blocked transpose kernels against the original row-of-pointers transpose.
+    Usage: transpose_bench [columns] [rows]
+*/
+
+#include "Transpose.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int repetitions = 5;
+
+    // The transpose carve used before the image buffer, kept here as the baseline
+    int **naiveTranspose(const int &numCols, const int &numRows, int **arr)
+    {
+        int **newArr = new int *[numCols];
+
+        for (auto i = 0; i < numCols; ++i)
+        {
+            newArr[i] = new int[numRows];
+
+            for (auto j = 0; j < numRows; ++j)
+            {
+                newArr[i][j] = arr[j][i];
+            }
+        }
+
+        return newArr;
+    }
+
+    template <typename Function>
+    double bestSeconds(Function function)
+    {
+        double best = 1e30;
+
+        for (auto r = 0; r < repetitions; ++r)
+        {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+
+        return best;
+    }
+
+    void report(const std::string &name, const double &seconds, const double &megapixels, const bool &correct)
+    {
+        cout << name << ": " << seconds * 1000 << " ms, " << megapixels / seconds << " MP/s"
+             << (correct ? "" : "  RESULT MISMATCH") << endl;
+    }
+
+    template <typename T>
+    Image<T> makeImage(const int &numCols, const int &numRows, const int &numChannels)
+    {
+        Image<T> image(numCols, numRows, numChannels);
+
+        for (std::size_t n = 0; n < image.data.size(); ++n)
+            image.data[n] = static_cast<T>(n * 2654435761u >> 7);
+
+        return image;
+    }
+
+    template <typename T>
+    bool isTransposeOf(const Image<T> &transposed, const Image<T> &image)
+    {
+        if (transposed.width != image.height || transposed.height != image.width)
+            return false;
+
+        for (auto i = 0; i < image.height; ++i)
+            for (auto j = 0; j < image.width; ++j)
+                for (auto k = 0; k < image.channels; ++k)
+                    if (transposed.at(j, i, k) != image.at(i, j, k))
+                        return false;
+
+        return true;
+    }
+
+    template <typename T>
+    void benchBlocked(const std::string &name, const int &numCols, const int &numRows, const int &numChannels)
+    {
+        const double megapixels = numCols * static_cast<double>(numRows) / 1e6;
+        Image<T> image = makeImage<T>(numCols, numRows, numChannels);
+        Image<T> transposed(numRows, numCols, numChannels);
+
+        double seconds = bestSeconds([&]() { transposeImage(image, transposed); });
+        report(name + " blocked", seconds, megapixels, isTransposeOf(transposed, image));
+
+        Image<T> inPlace = image;
+        seconds = bestSeconds([&]() { transposeImageInPlace(inPlace); });
+
+        // An odd number of repetitions leaves the image transposed
+        report(name + " in place", seconds, megapixels, isTransposeOf(inPlace, image));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const int numCols = argc > 1 ? atoi(argv[1]) : 6000;
+    const int numRows = argc > 2 ? atoi(argv[2]) : 4000;
+    const double megapixels = numCols * static_cast<double>(numRows) / 1e6;
+
+    cout << "Transposing " << numCols << " x " << numRows << ", best of " << repetitions << endl;
+
+    // Baseline: one allocation per row and a column-wise walk over the source
+    int **arr = new int *[numRows];
+    for (auto i = 0; i < numRows; ++i)
+    {
+        arr[i] = new int[numCols];
+        for (auto j = 0; j < numCols; ++j)
+            arr[i][j] = i * numCols + j;
+    }
+
+    double seconds = bestSeconds([&]() {
+        int **transposed = naiveTranspose(numCols, numRows, arr);
+        for (auto i = 0; i < numCols; ++i)
+            delete[] transposed[i];
+        delete[] transposed;
+    });
+    report("int    1ch naive  ", seconds, megapixels, true);
+
+    for (auto i = 0; i < numRows; ++i)
+        delete[] arr[i];
+    delete[] arr;
+
+    benchBlocked<int>("int    1ch", numCols, numRows, 1);
+    benchBlocked<uint8_t>("uint8  1ch", numCols, numRows, 1);
+    benchBlocked<uint16_t>("uint16 1ch", numCols, numRows, 1);
+    benchBlocked<uint8_t>("uint8  3ch", numCols, numRows, 3);
+
+    return 0;
+}